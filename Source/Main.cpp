@@ -23,7 +23,227 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 
-#include "base.h"
+#include "derived.h"
+#include "baseFactoryDatabase.h"
+#include "benchmarks.h"
+#include "configSchema.h"
+#include "dependencyContainer.h"
+#include "factoryRecord.h"
+#include "pooledFactory.h"
+#include "polyValue.h"
+
+#include <thread>
+#include <vector>
+
+
+static PooledFactory<Base, Smaller> pooledSmaller("pooled.smaller");
+
+// Base's own types are recorded, so lookups of their names never reach the 
+// registered factories; these are the same types registered as usual, for 
+// testing the HashMap and the frozen table.
+namespace RegisteredTypes
+{
+   constexpr TypeName kUnity("registered.unity");
+   constexpr TypeName kSmaller("registered.smaller");
+   constexpr TypeName kBigger("registered.bigger");
+}
+
+static Factory<Base, Unity> registeredUnity("registered.unity");
+static Factory<Base, Smaller> registeredSmaller("registered.smaller");
+static Factory<Base, Bigger> registeredBigger("registered.bigger");
+
+// the same class registered under two names, without any static 
+// initialization.
+FACTORY_RECORD(cf_base, Base, Smaller, "recorded.smaller"_type);
+FACTORY_RECORD(cf_base, Base, Smaller, "recorded.alias"_type);
+FACTORY_RECORD(cf_base, Base, Smaller, "recorded.concurrent"_type);
+FACTORY_RECORD_WITH_FACTORY(cf_base, Base, "recorded.pooled"_type, PooledFactory<Base, Smaller>);
+
+
+/**
+ * A Unity that records the order that objects are destroyed in.
+ */
+class Tracked : public Unity
+{
+public:
+   Tracked() : fId(sNextId++) {}
+   ~Tracked() { sDestroyed.add(fId); }
+
+   const int fId;
+   static std::atomic<int> sNextId;
+   static Array<int> sDestroyed;
+};
+
+std::atomic<int> Tracked::sNextId(0);
+Array<int> Tracked::sDestroyed;
+
+static Factory<Base, Tracked> trackedFactory("tracked");
+
+
+/**
+ * A Unity with a buffer that's worth keeping when it's recycled.
+ */
+class Buffered : public Unity
+{
+public:
+   Buffered() { ++sNumConstructed; }
+
+   void Reset() override 
+   { 
+      fBuffer.clearQuick(); 
+      ++sNumResets;
+   }
+
+   Array<int> fBuffer;
+   static int sNumConstructed;
+   static int sNumResets;
+};
+
+int Buffered::sNumConstructed = 0;
+int Buffered::sNumResets = 0;
+
+static Factory<Base, Buffered> bufferedFactory("buffered");
+
+
+/**
+ * A thread that creates some pooled objects and exits.
+ */
+class PooledMaker : public Thread
+{
+public:
+   PooledMaker() : Thread("pooled maker") {}
+
+   void run() override
+   {
+      for (int i = 0; i < 100; ++i)
+      {
+         fMade.add(Base::Create("pooled.smaller"));
+      }
+   }
+
+   OwnedArray<Base> fMade;
+};
+
+
+/**
+ * Leaves a pooled object in a `thread_local` that is destroyed after the 
+ * thread's magazine, so it's deleted once the magazine has gone.
+ */
+void HoldPooledUntilThreadExit()
+{
+   // constructed before the magazine, so destroyed after it.
+   static thread_local ScopedPointer<Base> held;
+   held = Base::Create("pooled.smaller");
+}
+
+
+/**
+ * A thread that waits to be told to start, then creates a recorded type 
+ * (along with a registered one) as quickly as it can.
+ */
+class RecordedMaker : public Thread
+{
+public:
+   explicit RecordedMaker(WaitableEvent& start) 
+   :  Thread("recorded maker")
+   ,  fStart(start)
+   {
+   }
+
+   void run() override
+   {
+      fStart.wait();
+      for (int i = 0; i < 100; ++i)
+      {
+         fMade.add(Base::Create("recorded.concurrent"));
+         fMade.add(Base::Create("unity"));
+      }
+   }
+
+   OwnedArray<Base> fMade;
+
+private:
+   WaitableEvent& fStart;
+};
+
+
+/**
+ * A Unity that needs to be configured after it's constructed.
+ */
+class Scaled : public Unity
+{
+public:
+   Scaled() : fFactor(1) {}
+
+   void SetFactor(int factor) { fFactor = factor; }
+
+   int SomeIntOperation(int input) override { return input * fFactor; }
+
+private:
+   int fFactor;
+};
+
+static Scaled MakeTripler()
+{
+   Scaled tripler;
+   tripler.SetFactor(3);
+   return tripler;
+}
+
+static PrototypeFactory<Base, Scaled> triplerFactory("tripler", MakeTripler());
+
+
+/**
+ * A Unity that can only be created with its final size and label.
+ */
+class Sized : public Unity
+{
+public:
+   Sized(int size, const String& label) 
+   :  fLabel(label)
+   {
+      fValues.insertMultiple(0, 0, size);
+   }
+
+   String SomeStringOperation(const String& input) override { return fLabel + input; }
+
+   Array<int> fValues;
+   const String fLabel;
+};
+
+static Factory<Base, Sized, int, const String&> sizedFactory("sized");
+
+// the same class, registered again to be created from a single argument.
+class Labelled : public Sized
+{
+public:
+   explicit Labelled(String label) : Sized(1, label) {}
+};
+
+static Factory<Base, Labelled, String> labelledFactory("labelled");
+
+
+/**
+ * A Unity that sets itself up from a config tree.
+ */
+class Configured : public Unity
+{
+public:
+   void Configure(const ValueTree& config) override
+   {
+      enum { kSize, kLabel };
+      static const ConfigSchema schema { "size", "label" };
+      fValues.insertMultiple(0, 0, schema.Get(config, kSize, 0));
+      fLabel = schema.Get(config, kLabel).toString();
+   }
+
+   String SomeStringOperation(const String& input) override { return fLabel + input; }
+
+   Array<int> fValues;
+   String fLabel;
+};
+
+static Factory<Base, Configured> configuredFactory("configured");
 
 
 /**
@@ -69,6 +289,778 @@ public:
       expect(kTestString == unity->SomeStringOperation(kTestString));
       expect(kTestString.toLowerCase() == smaller->SomeStringOperation(kTestString));
       expect(kTestString.toUpperCase() == bigger->SomeStringOperation(kTestString));
+
+      beginTest("type names");
+      expect(unity->GetTypeName() == "unity");
+      expect(bigger->GetTypeName() == "bigger");
+      expect(nullptr != smaller->GetDescriptor());
+      expect(sizeof(Smaller) == smaller->GetDescriptor()->GetSize());
+      expect(BaseTypes::kSmaller.GetHash() == smaller->GetDescriptor()->GetHash());
+      expect(Base::Resolve("smaller").GetFactory() == smaller->GetDescriptor()->GetFactory());
+      // objects made from the same factory share one descriptor.
+      ScopedPointer<Base> anotherSmaller = Base::Create("smaller");
+      expect(smaller->GetDescriptor() == anotherSmaller->GetDescriptor());
+      Unity direct;
+      expect(nullptr == direct.GetDescriptor());
+      expect(direct.GetTypeName() == "!!UNKNOWN!!");
+
+      beginTest("type identity");
+      expect(Base::Resolve("bigger").GetFactory() == bigger->GetFactory());
+      expect(BaseTypes::kBigger.GetHash() == bigger->GetTypeId());
+      expect(TypeNameHash::Calculate(unity->GetTypeName()) == unity->GetTypeId());
+      expect(smaller->GetTypeId() == anotherSmaller->GetTypeId());
+      expect(smaller->GetTypeId() != bigger->GetTypeId());
+      expect(nullptr == direct.GetFactory());
+      expect(0 == direct.GetTypeId());
+      {
+         ScopedPointer<Base> sameType = bigger->CloneSameType();
+         expect(nullptr != sameType);
+         expect(sameType.get() != bigger.get());
+         expect(sameType->GetTypeId() == bigger->GetTypeId());
+         expect(101 == sameType->SomeIntOperation(100));
+      }
+
+      beginTest("factory records");
+      {
+         ScopedPointer<Base> recorded = Base::Create("recorded.smaller");
+         expect(nullptr != recorded);
+         expect(99 == recorded->SomeIntOperation(100));
+         expect(recorded->GetTypeName() == "recorded.smaller");
+         ScopedPointer<Base> alias = Base::Create("recorded.alias"_type);
+         expect(alias->GetTypeName() == "recorded.alias");
+         expect(alias->GetFactory() != recorded->GetFactory());
+         // recorded factories are always found through their records.
+         expect(Base::Resolve("recorded.smaller").GetFactory() == recorded->GetFactory());
+         expect(nullptr == Base::Create("recorded.imaginary"));
+         // records are looked up first, and names that aren't recorded go 
+         // on to the registered factories, with or without a thread cache.
+         BaseFactoryDatabase::EnableThreadCache(true);
+         expect(Base::Resolve("recorded.smaller").GetFactory() == recorded->GetFactory());
+         expect(nullptr != Base::Resolve("buffered").GetFactory());
+         expect(nullptr == Base::Resolve("recorded.imaginary").GetFactory());
+         BaseFactoryDatabase::EnableThreadCache(false);
+         ScopedPointer<Base> pooled = Base::Create("recorded.pooled");
+         expect(nullptr != dynamic_cast<PooledObject<Smaller>*>(pooled.get()));
+      }
+
+      beginTest("recorded types from several threads");
+      {
+         // nothing has used this record yet, so all of the threads race to 
+         // create its factory while the others look up a registered type.
+         WaitableEvent start(true);
+         OwnedArray<RecordedMaker> makers;
+         for (int i = 0; i < 4; ++i)
+         {
+            makers.add(new RecordedMaker(start))->startThread();
+         }
+         start.signal();
+         for (RecordedMaker* maker : makers)
+         {
+            expect(maker->waitForThreadToExit(5000));
+         }
+         const BaseFactory<Base>* factory = Base::Resolve("recorded.concurrent").GetFactory();
+         expect(nullptr != factory);
+         bool allMade = true;
+         for (RecordedMaker* maker : makers)
+         {
+            allMade = allMade && (200 == maker->fMade.size());
+            for (int i = 0; i < maker->fMade.size(); i += 2)
+            {
+               allMade = allMade && (nullptr != maker->fMade[i]) 
+                  && (maker->fMade[i]->GetFactory() == factory)
+                  && (nullptr != maker->fMade[i + 1]);
+            }
+         }
+         expect(allMade);
+      }
+
+      beginTest("factory record index");
+      {
+         StringArray names;
+         Array<FactoryRecord<Base> > records;
+         for (int i = 0; i < 1000; ++i)
+         {
+            names.add("indexed." + String(i));
+         }
+         for (const String& name : names)
+         {
+            FactoryRecord<Base> record = { name.toRawUTF8(), name.getNumBytesAsUTF8(), 
+               TypeNameHash::Calculate(name), nullptr };
+            records.add(record);
+         }
+         // a name with the same hash as another one.
+         FactoryRecord<Base> collision = { "collision", 9, records[500].hash, nullptr };
+         records.add(collision);
+
+         const FactoryRecordIndex<Base> index(records.begin(), records.end());
+         expect(1001 == index.size());
+         expect(! index.HasDistinctHashes());
+         bool allFound = true;
+         for (int i = 0; i < records.size(); ++i)
+         {
+            const FactoryRecord<Base>& record = records.getReference(i);
+            allFound = allFound 
+               && (&record == index.Find(record.name, record.length, record.hash));
+         }
+         expect(allFound);
+         expect(nullptr == index.Find("indexed.1000", 12, TypeNameHash::Calculate("indexed.1000")));
+         expect(nullptr == index.Find("indexed.5", 9, records[6].hash));
+
+         const FactoryRecordIndex<Base> distinct(records.begin(), records.begin() + 1000);
+         expect(distinct.HasDistinctHashes());
+
+         const FactoryRecordIndex<Base> empty(nullptr, nullptr);
+         expect(0 == empty.size());
+         expect(empty.HasDistinctHashes());
+         expect(nullptr == empty.Find("unity", 5, BaseTypes::kUnity.GetHash()));
+      }
+
+      beginTest("factory handles");
+      FactoryHandle<Base> smallerHandle = Base::Resolve("smaller");
+      expect(smallerHandle.IsValid());
+      expect(smallerHandle == Base::Resolve("smaller"));
+      expect(smallerHandle != Base::Resolve("bigger"));
+      
+      ScopedPointer<Base> fromHandle = Base::Create(smallerHandle);
+      expect(nullptr != fromHandle);
+      expect(99 == fromHandle->SomeIntOperation(100));
+      
+      // unknown names resolve to an invalid handle that creates nothing.
+      FactoryHandle<Base> notThereHandle = Base::Resolve("imaginary");
+      expect(!notThereHandle.IsValid());
+      expect(nullptr == Base::Create(notThereHandle));
+
+      beginTest("frozen database");
+      const FactoryHandle<Base> registeredHandle = Base::Resolve("registered.smaller");
+      expect(registeredHandle.IsValid());
+      expect(BaseFactoryDatabase::Freeze());
+      expect(BaseFactoryDatabase::IsFrozen());
+      expect(registeredHandle == Base::Resolve("registered.smaller"));
+      ScopedPointer<Base> frozenUnity = Base::Create("registered.unity");
+      expect(nullptr != frozenUnity);
+      expect(100 == frozenUnity->SomeIntOperation(100));
+      expect(nullptr == Base::Create("imaginary"));
+      expect(nullptr == Base::Create("registered.smalle"));
+      expect(nullptr == Base::Create("registered.smallerr"));
+      // recorded types are still found while the table is frozen.
+      expect(smallerHandle == Base::Resolve("smaller"));
+
+      // registering after freezing rebuilds the table, including names that
+      // are too long to be stored inline in the table.
+      static Factory<Base, Bigger> lateFactory("aVeryLongTypeNameThatWillNotFitInsideOneTableSlot");
+      expect(BaseFactoryDatabase::IsFrozen());
+      ScopedPointer<Base> late = Base::Create("aVeryLongTypeNameThatWillNotFitInsideOneTableSlot");
+      expect(nullptr != late);
+      expect(101 == late->SomeIntOperation(100));
+      expect(nullptr == Base::Create("aVeryLongTypeNameThatWillNotFitInsideOneTableSlotX"));
+      ScopedPointer<Base> stillThere = Base::Create("registered.bigger");
+      expect(nullptr != stillThere);
+
+      BaseFactoryDatabase::Thaw();
+      expect(! BaseFactoryDatabase::IsFrozen());
+
+      beginTest("compile-time type names");
+      static_assert(BaseTypes::kSmaller.GetHash() == "smaller"_type.GetHash(), "");
+      expect(TypeNameHash::Calculate("smaller") == BaseTypes::kSmaller.GetHash());
+      expect(TypeNameHash::Calculate("aVeryLongTypeNameThatWillNotFitInsideOneTableSlot") 
+         == "aVeryLongTypeNameThatWillNotFitInsideOneTableSlot"_type.GetHash());
+      
+      constexpr TypeName kDuplicated[] = { BaseTypes::kUnity, BaseTypes::kBigger, BaseTypes::kUnity };
+      expect(! TypeName::AreDistinct(kDuplicated));
+
+      // a constant buffer that's bigger than the name in it.
+      static constexpr char kPadded[32] = "smaller";
+      constexpr TypeName padded(kPadded);
+      static_assert(7 == padded.GetLength(), "");
+      static_assert(padded.GetHash() == BaseTypes::kSmaller.GetHash(), "");
+      // ...but not one that could change after it's been hashed.
+      static_assert(! std::is_constructible<TypeName, char (&)[32]>::value, "");
+      expect(nullptr != ScopedPointer<Base>(Base::Create(padded)).get());
+
+      // registered types go through the HashMap and then the frozen table,
+      // recorded ones through the record index either way.
+      for (int frozen = 0; frozen < 2; ++frozen)
+      {
+         if (frozen)
+         {
+            expect(BaseFactoryDatabase::Freeze());
+         }
+         ScopedPointer<Base> fromTypeName = Base::Create(RegisteredTypes::kBigger);
+         expect(nullptr != fromTypeName);
+         expect(101 == fromTypeName->SomeIntOperation(100));
+         ScopedPointer<Base> fromLiteral = Base::Create("registered.unity"_type);
+         expect(nullptr != fromLiteral);
+         expect(100 == fromLiteral->SomeIntOperation(100));
+         expect(nullptr == Base::Create("imaginary"_type));
+         expect(nullptr == Base::Create("registered.unit"_type));
+
+         ScopedPointer<Base> recorded = Base::Create(BaseTypes::kBigger);
+         expect(nullptr != recorded);
+         expect(101 == recorded->SomeIntOperation(100));
+      }
+      BaseFactoryDatabase::Thaw();
+
+      {
+         // the handle is resolved once, the first time; resolve it while the
+         // table is frozen.
+         expect(BaseFactoryDatabase::Freeze());
+         ScopedPointer<Base> fromTemplate = Base::Create<RegisteredTypes::kSmaller>();
+         expect(nullptr != fromTemplate);
+         expect(99 == fromTemplate->SomeIntOperation(100));
+         BaseFactoryDatabase::Thaw();
+         ScopedPointer<Base> fromRecordedTemplate = Base::Create<BaseTypes::kSmaller>();
+         expect(nullptr != fromRecordedTemplate);
+         expect(99 == fromRecordedTemplate->SomeIntOperation(100));
+      }
+
+      beginTest("constructor arguments");
+      {
+         ScopedPointer<Base> sized = Base::CreateWith<int, const String&>("sized", 16, "big:");
+         expect(nullptr != sized);
+         expect(sized->GetTypeName() == "sized");
+         expect(16 == dynamic_cast<Sized*>(sized.get())->fValues.size());
+         expect(sized->SomeStringOperation("x") == "big:x");
+
+         ScopedPointer<Base> labelled = Base::CreateWith<String>(Base::Resolve("labelled"), 
+            String("small:"));
+         expect(nullptr != labelled);
+         expect(1 == dynamic_cast<Sized*>(labelled.get())->fValues.size());
+         expect(labelled->SomeStringOperation("x") == "small:x");
+         // ...and it can still be copied.
+         ScopedPointer<Base> copy = labelled->Clone();
+         expect(copy->SomeStringOperation("x") == "small:x");
+
+         // types without arguments are created with CreateWith<>().
+         ScopedPointer<Base> unityWith = Base::CreateWith<>(BaseTypes::kUnity);
+         expect(nullptr != unityWith);
+         expect(unityWith->GetTypeName() == "unity");
+         ScopedPointer<Base> triplerWith = Base::CreateWith<>("tripler");
+         expect(300 == triplerWith->SomeIntOperation(100));
+         expect(nullptr == Base::CreateWith<int>("imaginary", 1));
+
+         // types that need arguments can't be created without them.
+         expect(! Base::Resolve("sized").GetFactory()->CanCreate());
+         expect(Base::Resolve("tripler").GetFactory()->CanCreate());
+         expect(nullptr == Base::Create("sized"));
+         expect(nullptr == Base::CreateUnique("labelled"));
+         alignas(std::max_align_t) char buffer[256];
+         expect(nullptr == Base::CreateAt("sized", buffer));
+         expect(! PolyValue<Base, 256>("sized").IsValid());
+         ThreadPool pool(1);
+         expect(! Base::Prewarm("sized", 4, pool));
+         std::vector<FactoryPtr<Base> > many = Base::CreateMany(StringArray::fromTokens("sized unity", false), pool);
+         expect(nullptr == many[0] && nullptr != many[1]);
+      }
+
+      beginTest("creating from a config tree");
+      {
+         ValueTree config("node");
+         config.setProperty("type", "configured", nullptr);
+         config.setProperty("size", 8, nullptr);
+         config.setProperty("label", "cfg:", nullptr);
+         ScopedPointer<Base> configured = Base::Create(config);
+         expect(nullptr != configured);
+         expect(configured->GetTypeName() == "configured");
+         expect(8 == dynamic_cast<Configured*>(configured.get())->fValues.size());
+         expect(configured->SomeStringOperation("x") == "cfg:x");
+
+         // properties that aren't there are left at their defaults.
+         config.removeProperty("size", nullptr);
+         configured = Base::Create(Base::Resolve("configured"), config);
+         expect(0 == dynamic_cast<Configured*>(configured.get())->fValues.size());
+
+         // types that don't override Configure() ignore the rest of the tree.
+         config.setProperty("type", "smaller", nullptr);
+         ScopedPointer<Base> smallerFromConfig = Base::Create(config);
+         expect(99 == smallerFromConfig->SomeIntOperation(100));
+
+         config.setProperty("type", "imaginary", nullptr);
+         expect(nullptr == Base::Create(config));
+         config.removeProperty("type", nullptr);
+         expect(nullptr == Base::Create(config));
+      }
+
+      beginTest("asynchronous creation");
+      {
+         ThreadPool pool(2);
+         WaitableEvent created;
+         Thread::ThreadID creatingThread = nullptr;
+         FactoryPtr<Base> asyncObject;
+         expect(Base::CreateAsync("smaller", pool, 
+            [&created, &creatingThread, &asyncObject] (FactoryPtr<Base> object)
+            {
+               creatingThread = Thread::getCurrentThreadId();
+               asyncObject = std::move(object);
+               created.signal();
+            }));
+         expect(created.wait(10000));
+         expect(nullptr != asyncObject);
+         expect(99 == asyncObject->SomeIntOperation(100));
+         expect(creatingThread != Thread::getCurrentThreadId());
+
+         expect(! Base::CreateAsync("imaginary", pool, [this] (FactoryPtr<Base>)
+            {
+               expect(false);
+            }));
+
+         // configured on the pool too.
+         ValueTree config("node");
+         config.setProperty("type", "configured", nullptr);
+         config.setProperty("label", "async:", nullptr);
+         std::future<FactoryPtr<Base> > future = Base::CreateFuture(config, pool);
+         FactoryPtr<Base> fromFuture = future.get();
+         expect(nullptr != fromFuture);
+         expect(fromFuture->SomeStringOperation("x") == "async:x");
+         expect(nullptr == Base::CreateFuture("imaginary", pool).get());
+         expect(nullptr != Base::CreateFuture(BaseTypes::kBigger, pool).get());
+
+         // delivered on the message thread (which is this one).
+         MessageManager* messageManager = MessageManager::getInstance();
+         expect(messageManager->isThisTheMessageThread());
+         bool delivered = false;
+         expect(Base::CreateAsync(BaseTypes::kUnity, pool, 
+            [&delivered, messageManager] (FactoryPtr<Base> object)
+            {
+               delivered = (nullptr != object && messageManager->isThisTheMessageThread());
+            }, AsyncDelivery::kMessageThread));
+         for (int i = 0; i < 1000 && ! delivered; ++i)
+         {
+            messageManager->runDispatchLoopUntil(10);
+         }
+         expect(delivered);
+
+         // an object whose message is never delivered is still destroyed.
+         Tracked::sDestroyed.clearQuick();
+         const int undeliveredId = Tracked::sNextId;
+         {
+            ThreadPool onePool(1);
+            expect(Base::CreateAsync("tracked", onePool, [this] (FactoryPtr<Base>)
+               {
+                  expect(false);
+               }, AsyncDelivery::kMessageThread));
+            while (onePool.getNumJobs() > 0)
+            {
+               Thread::sleep(1);
+            }
+         }
+         expect(Tracked::sDestroyed.isEmpty());
+         // this drops the pending message.
+         MessageManager::deleteInstance();
+         expect(Tracked::sDestroyed.contains(undeliveredId));
+      }
+
+      beginTest("creating lists in parallel");
+      {
+         ThreadPool pool(2);
+         StringArray names;
+         for (int i = 0; i < 5000; ++i)
+         {
+            names.add(BaseTypes::kAll[i % 3].GetName());
+         }
+         names.set(1234, "imaginary");
+         std::vector<FactoryPtr<Base> > objects = Base::CreateMany(names, pool);
+         expect(5000 == objects.size());
+         bool inOrder = true;
+         for (int i = 0; i < 5000; ++i)
+         {
+            if (1234 == i)
+            {
+               expect(nullptr == objects[i]);
+            }
+            else 
+            {
+               inOrder = inOrder && (objects[i]->GetTypeName() == names[i]);
+            }
+         }
+         expect(inOrder);
+         expect(Base::CreateMany(StringArray(), pool).empty());
+
+         ValueTree specs("nodes");
+         for (int i = 0; i < 600; ++i)
+         {
+            ValueTree spec("node");
+            spec.setProperty("type", (i % 2) ? "configured" : "smaller", nullptr);
+            spec.setProperty("label", String(i) + ":", nullptr);
+            specs.addChild(spec, -1, nullptr);
+         }
+         specs.addChild(ValueTree("untyped"), -1, nullptr);
+         std::vector<FactoryPtr<Base> > configured = Base::CreateMany(specs, pool);
+         expect(601 == configured.size());
+         expect(configured[0]->SomeStringOperation("X") == "x");
+         expect(configured[599]->SomeStringOperation("x") == "599:x");
+         expect(nullptr == configured[600]);
+      }
+
+      beginTest("pooled factory");
+      {
+         const ObjectPool::Stats before = pooledSmaller.GetPoolStats();
+         OwnedArray<Base> pooled;
+         for (int i = 0; i < 10; ++i)
+         {
+            pooled.add(Base::Create("pooled.smaller"));
+            expect(99 == pooled.getLast()->SomeIntOperation(100));
+            expect(pooled.getLast()->GetTypeName() == "pooled.smaller");
+            expect(nullptr != dynamic_cast<Smaller*>(pooled.getLast()));
+         }
+         // deleting them returns their memory to the pool...
+         pooled.clear();
+         const ObjectPool::Stats emptied = pooledSmaller.GetPoolStats();
+         expect(0 == emptied.live);
+         expect(10 <= emptied.highWater);
+         expect(before.allocations + 10 == emptied.allocations);
+
+         // ...where it's reused, most recently freed first.
+         ScopedPointer<Base> reused = Base::Create("pooled.smaller");
+         const ObjectPool::Stats after = pooledSmaller.GetPoolStats();
+         expect(emptied.magazineHits + 1 == after.magazineHits);
+         expect(emptied.depotTrips == after.depotTrips);
+         expect(1 == after.live);
+
+         // CreateWith<>() uses the pool too.
+         ScopedPointer<Base> with = Base::CreateWith<>("pooled.smaller");
+         expect(nullptr != dynamic_cast<PooledObject<Smaller>*>(with.get()));
+         expect(2 == pooledSmaller.GetPoolStats().live);
+      }
+
+      beginTest("pooled objects freed on another thread");
+      {
+         const int live = pooledSmaller.GetPoolStats().live;
+         // made on another thread, so that its magazine has come and gone...
+         PooledMaker maker;
+         maker.startThread();
+         expect(maker.waitForThreadToExit(5000));
+         expect(100 == maker.fMade.size());
+         expect(live + 100 == pooledSmaller.GetPoolStats().live);
+         // ...and freed on this one.
+         maker.fMade.clear();
+         expect(live == pooledSmaller.GetPoolStats().live);
+      }
+
+      beginTest("pooled objects freed after the thread's magazine");
+      {
+         const int live = pooledSmaller.GetPoolStats().live;
+         // join() (unlike Thread::waitForThreadToExit()) waits for the 
+         // thread's thread_locals to be destroyed.
+         std::thread holder(&HoldPooledUntilThreadExit);
+         holder.join();
+         expect(live == pooledSmaller.GetPoolStats().live);
+      }
+
+      beginTest("unique pointers");
+      {
+         FactoryPtr<Base> unique = Base::CreateUnique("bigger");
+         expect(nullptr != unique);
+         expect(101 == unique->SomeIntOperation(100));
+         expect(nullptr == Base::CreateUnique("imaginary"));
+
+         const int live = pooledSmaller.GetPoolStats().live;
+         FactoryPtr<Base> pooled = Base::CreateUnique(Base::Resolve("pooled.smaller"));
+         expect(99 == pooled->SomeIntOperation(100));
+         expect(live + 1 == pooledSmaller.GetPoolStats().live);
+         pooled.reset();
+         expect(live == pooledSmaller.GetPoolStats().live);
+
+         Tracked::sDestroyed.clearQuick();
+         FactoryPtr<Base> tracked = Base::CreateUnique("tracked"_type);
+         tracked = nullptr;
+         expect(1 == Tracked::sDestroyed.size());
+      }
+
+      beginTest("placement creation");
+      {
+         const FactoryLayout layout = Base::GetLayout("tracked");
+         expect(sizeof(Tracked) == layout.size);
+         expect(alignof(Tracked) == layout.alignment);
+         expect(0 == Base::GetLayout("imaginary").size);
+         expect(alignof(Smaller) == Base::GetLayout(BaseTypes::kSmaller).alignment);
+
+         alignas(std::max_align_t) char buffer[128];
+         expect(layout.size <= sizeof(buffer));
+         Tracked::sDestroyed.clearQuick();
+         Base* inPlace = Base::CreateAt("tracked", buffer);
+         expect(nullptr != inPlace);
+         expect(static_cast<void*>(buffer) == dynamic_cast<void*>(inPlace));
+         expect(100 == inPlace->SomeIntOperation(100));
+         expect(inPlace->GetTypeName() == "tracked");
+         inPlace->~Base();
+         expect(1 == Tracked::sDestroyed.size());
+         expect(nullptr == Base::CreateAt("imaginary", buffer));
+      }
+
+      beginTest("batch creation");
+      {
+         Tracked::sDestroyed.clearQuick();
+         {
+            FactoryBatch<Base> batch = Base::CreateBatch("tracked", 100);
+            expect(100 == batch.size());
+            expect(batch.GetStride() >= sizeof(Tracked));
+            int count = 0;
+            for (Base* b : batch)
+            {
+               expect(100 == b->SomeIntOperation(100));
+               expect(b->GetTypeName() == "tracked");
+               ++count;
+            }
+            expect(100 == count);
+            expect(batch.GetStride() == static_cast<size_t>(
+               reinterpret_cast<char*>(batch[1]) - reinterpret_cast<char*>(batch[0])));
+
+            // moving hands the objects over without destroying any.
+            FactoryBatch<Base> moved(std::move(batch));
+            expect(batch.IsEmpty());
+            expect(100 == moved.size());
+            expect(0 == Tracked::sDestroyed.size());
+         }
+         expect(100 == Tracked::sDestroyed.size());
+         expect(Tracked::sDestroyed.getFirst() > Tracked::sDestroyed.getLast());
+
+         expect(Base::CreateBatch("imaginary", 10).IsEmpty());
+         FactoryBatch<Base> smallers = Base::CreateBatch(BaseTypes::kSmaller, 3);
+         expect(99 == smallers[2]->SomeIntOperation(100));
+
+         // types that need constructor arguments can't be batched.
+         expect(Base::CreateBatch("sized", 10).IsEmpty());
+         FactoryBatch<Base> direct(*Base::Resolve("sized").GetFactory(), 10);
+         expect(direct.IsEmpty());
+      }
+
+      beginTest("cloning");
+      {
+         ScopedPointer<Base> clone = bigger->Clone();
+         expect(nullptr != clone && clone != bigger);
+         expect(101 == clone->SomeIntOperation(100));
+         expect(clone->GetDescriptor() == bigger->GetDescriptor());
+
+         ScopedPointer<Base> pooled = Base::Create("pooled.smaller");
+         const int live = pooledSmaller.GetPoolStats().live;
+         ScopedPointer<Base> pooledClone = pooled->Clone();
+         expect(99 == pooledClone->SomeIntOperation(100));
+         expect(live + 1 == pooledSmaller.GetPoolStats().live);
+      }
+
+      beginTest("prototypes");
+      {
+         ScopedPointer<Base> tripler = Base::Create("tripler");
+         expect(nullptr != tripler);
+         expect(15 == tripler->SomeIntOperation(5));
+         expect(tripler->GetTypeName() == "tripler");
+         // the prototype itself is never handed out.
+         expect(tripler != static_cast<const Base*>(&triplerFactory.GetPrototype()));
+
+         ScopedPointer<Base> clone = tripler->Clone();
+         expect(15 == clone->SomeIntOperation(5));
+         expect(clone->GetTypeName() == "tripler");
+
+         ObjectArena arena;
+         expect(15 == Base::Create("tripler", arena)->SomeIntOperation(5));
+         FactoryBatch<Base> batch = Base::CreateBatch("tripler", 4);
+         expect(15 == batch[3]->SomeIntOperation(5));
+         FactoryPtr<Base> unique = Base::CreateUnique("tripler");
+         expect(15 == unique->SomeIntOperation(5));
+      }
+
+      beginTest("prewarming");
+      {
+         ThreadPool pool(2);
+         const int firstId = Tracked::sNextId;
+         expect(Base::Prewarm("tracked", 300, pool));
+         expect(! Base::Prewarm("imaginary", 300, pool));
+         HashMap<String, int> counts;
+         counts.set("unity", 10);
+         counts.set("imaginary", 10);
+         expect(1 == Base::Prewarm(counts, pool));
+         while (pool.getNumJobs() > 0)
+         {
+            Thread::sleep(1);
+         }
+         expect(300 == trackedFactory.GetNumParked());
+         expect(firstId + 300 == Tracked::sNextId);
+
+         // handed out without constructing anything new.
+         ScopedPointer<Base> warm = Base::Create("tracked");
+         FactoryPtr<Base> uniqueWarm = Base::CreateUnique("tracked");
+         expect(firstId + 300 == Tracked::sNextId);
+         expect(298 == trackedFactory.GetNumParked());
+         // ...which doesn't count as recycling.
+         const RecycleStats warmStats = Base::GetRecycleStats("tracked");
+         expect(2 == warmStats.prewarmed);
+         expect(0 == warmStats.hits);
+         expect(warm->GetTypeName() == "tracked");
+         expect(100 == warm->SomeIntOperation(100));
+
+         Base::DiscardPrewarmed("tracked");
+         Base::DiscardPrewarmed("unity");
+         expect(0 == trackedFactory.GetNumParked());
+         warm = Base::Create("tracked");
+         expect(firstId + 301 == Tracked::sNextId);
+      }
+
+      beginTest("recycling");
+      {
+         expect(Base::SetRecycling("buffered", 2));
+         expect(! Base::SetRecycling("imaginary", 2));
+         const int constructed = Buffered::sNumConstructed;
+
+         FactoryPtr<Base> first = Base::CreateUnique("buffered");
+         Buffered* firstObject = dynamic_cast<Buffered*>(first.get());
+         firstObject->fBuffer.add(1);
+         first = nullptr;
+         expect(1 == Buffered::sNumResets);
+         expect(1 == bufferedFactory.GetNumParked());
+
+         // the same object comes back, reset, without being constructed.
+         FactoryPtr<Base> again = Base::CreateUnique("buffered");
+         expect(again.get() == static_cast<Base*>(firstObject));
+         expect(firstObject->fBuffer.isEmpty());
+         expect(constructed + 1 == Buffered::sNumConstructed);
+
+         // raw pointers can be recycled with Release().
+         Base* a = Base::Create("buffered");
+         Base* b = Base::Create("buffered");
+         Base::Release(a);
+         Base::Release(b);
+         again.reset();
+         // ...but only up to the limit.
+         expect(2 == bufferedFactory.GetNumParked());
+
+         const RecycleStats stats = Base::GetRecycleStats("buffered");
+         expect(2 == stats.maxCached);
+         expect(1 == stats.hits);
+         expect(3 == stats.misses);
+         expect(3 == stats.recycled);
+         expect(1 == stats.discarded);
+         expect(0 == stats.prewarmed);
+
+         // recycled and prewarmed objects are counted separately.
+         bufferedFactory.Park(bufferedFactory.Create());
+         expect(3 == bufferedFactory.GetNumParked());
+         OwnedArray<Base> taken;
+         for (int i = 0; i < 3; ++i)
+         {
+            taken.add(Base::Create("buffered"));
+         }
+         const RecycleStats mixed = Base::GetRecycleStats("buffered");
+         expect(stats.hits + 2 == mixed.hits);
+         expect(1 == mixed.prewarmed);
+         expect(stats.misses == mixed.misses);
+         taken.clear();
+
+         expect(Base::SetRecycling("buffered", 0));
+         Base::DiscardPrewarmed("buffered");
+         expect(0 == bufferedFactory.GetNumParked());
+      }
+
+      beginTest("object arena");
+      {
+         // small blocks, so that we need more than one.
+         ObjectArena arena(256);
+         Tracked::sDestroyed.clearQuick();
+         const int firstId = Tracked::sNextId;
+         for (int i = 0; i < 20; ++i)
+         {
+            Base* obj = Base::Create("tracked", arena);
+            expect(nullptr != obj);
+            expect(100 == obj->SomeIntOperation(100));
+            expect(obj->GetTypeName() == "tracked");
+         }
+         expect(nullptr == Base::Create("imaginary", arena));
+         Base* smallerInArena = Base::Create(BaseTypes::kSmaller, arena);
+         expect(99 == smallerInArena->SomeIntOperation(100));
+         expect(21 == arena.GetNumObjects());
+         const size_t capacity = arena.GetCapacity();
+         expect(capacity > 256);
+
+         arena.Reset();
+         expect(0 == arena.GetNumObjects());
+         expect(20 == Tracked::sDestroyed.size());
+         for (int i = 0; i < Tracked::sDestroyed.size(); ++i)
+         {
+            // newest first.
+            expect(firstId + 19 - i == Tracked::sDestroyed[i]);
+         }
+
+         // the memory gets reused.
+         for (int i = 0; i < 20; ++i)
+         {
+            Base::Create("tracked", arena);
+         }
+         expect(capacity == arena.GetCapacity());
+         // pooled factories create plain objects in an arena.
+         expect(nullptr != Base::Create("pooled.smaller", arena));
+      }
+      expect(40 == Tracked::sDestroyed.size());
+
+      beginTest("poly values");
+      {
+         PolyValue<Base> empty;
+         expect(! empty.IsValid());
+         expect(! PolyValue<Base>("imaginary").IsValid());
+
+         PolyValue<Base> smaller(BaseTypes::kSmaller);
+         expect(smaller.IsInline());
+         expect(99 == smaller->SomeIntOperation(100));
+         expect(smaller->GetTypeName() == "smaller");
+
+         // too big to store inline.
+         PolyValue<Base, 8> onHeap("bigger");
+         expect(onHeap.IsValid());
+         expect(! onHeap.IsInline());
+         expect(101 == onHeap->SomeIntOperation(100));
+         PolyValue<Base, 8> movedHeap(std::move(onHeap));
+         expect(! onHeap.IsValid());
+         expect(101 == movedHeap->SomeIntOperation(100));
+
+         // moving an inline object moves the object itself.
+         PolyValue<Base> moved(std::move(smaller));
+         expect(! smaller.IsValid());
+         expect(moved.IsInline());
+         expect(99 == (*moved).SomeIntOperation(100));
+         smaller = std::move(moved);
+         expect(smaller.IsInline());
+         expect(smaller->GetTypeName() == "smaller");
+
+         // ...keeping its state.
+         PolyValue<Base, 64> tripler("tripler");
+         expect(tripler.IsInline());
+         PolyValue<Base, 64> movedTripler(std::move(tripler));
+         expect(300 == movedTripler->SomeIntOperation(100));
+
+         std::vector<PolyValue<Base> > values;
+         for (int i = 0; i < 10; ++i)
+         {
+            // growing the vector moves the values.
+            values.emplace_back(BaseTypes::kAll[i % 3]);
+         }
+         for (int i = 0; i < 10; ++i)
+         {
+            expect(values[i].IsInline());
+            expect(values[i]->GetTypeName() == BaseTypes::kAll[i % 3].GetName());
+         }
+
+         Tracked::sDestroyed.clearQuick();
+         {
+            std::vector<PolyValue<Base> > tracked;
+            tracked.reserve(10);
+            for (int i = 0; i < 10; ++i)
+            {
+               tracked.emplace_back("tracked");
+            }
+            tracked[0].Clear();
+            expect(! tracked[0].IsValid());
+            expect(1 == Tracked::sDestroyed.size());
+         }
+         expect(10 == Tracked::sDestroyed.size());
+
+         // a recycling factory gets heap objects back when they're released.
+         expect(Base::SetRecycling("buffered", 1));
+         {
+            PolyValue<Base, 8> buffered("buffered");
+            expect(! buffered.IsInline());
+         }
+         expect(1 == bufferedFactory.GetNumParked());
+         expect(Base::SetRecycling("buffered", 0));
+         Base::DiscardPrewarmed("buffered");
+      }
    }
    
 };
@@ -76,13 +1068,462 @@ public:
 
 static FactoryTest test;
 
+
+/**
+ * @class SnapshotPointerTest
+ * @brief Hammer a SnapshotPointer from several reader threads while it's 
+ *        being republished, and make sure that readers only ever see intact
+ *        snapshots and that every retired snapshot is eventually deleted.
+ */
+class SnapshotPointerTest : public UnitTest
+{
+public:
+   SnapshotPointerTest() : UnitTest("Snapshot Pointer Tests")
+   {
+   }
+
+   void runTest() override
+   {
+      beginTest("concurrent readers and writer");
+      SnapshotPointer<Snapshot> pointer;
+      {
+         const ScopedLock sl(pointer.GetWriterLock());
+         pointer.Publish(new Snapshot(0));
+      }
+
+      std::atomic<int> errors(0);
+      OwnedArray<Reader> readers;
+      for (int i = 0; i < 4; ++i)
+      {
+         readers.add(new Reader(pointer, errors))->startThread();
+      }
+      for (int i = 1; i <= 2000; ++i)
+      {
+         const ScopedLock sl(pointer.GetWriterLock());
+         pointer.Publish(new Snapshot(i));
+      }
+      readers.clear();
+
+      expect(0 == errors.load());
+      {
+         const ScopedLock sl(pointer.GetWriterLock());
+         expect(0 == pointer.Reclaim());
+      }
+      expect(1 == Snapshot::sLive.load());
+      const SnapshotPointer<Snapshot>::ReadGuard last(pointer);
+      expect(2000 == last->fValue);
+   }
+
+private:
+   struct Snapshot
+   {
+      explicit Snapshot(int value) : fValue(value), fCheck(~value) { ++sLive; }
+      ~Snapshot() { fCheck = fValue; --sLive; }
+      int fValue;
+      int fCheck;
+      static std::atomic<int> sLive;
+   };
+
+   class Reader : public Thread
+   {
+   public:
+      Reader(SnapshotPointer<Snapshot>& pointer, std::atomic<int>& errors)
+      :  Thread("snapshot reader")
+      ,  fPointer(pointer)
+      ,  fErrors(errors)
+      {
+      }
+
+      ~Reader()
+      {
+         stopThread(5000);
+      }
+
+      void run() override
+      {
+         while (! threadShouldExit())
+         {
+            const SnapshotPointer<Snapshot>::ReadGuard snapshot(fPointer);
+            if (snapshot->fCheck != ~snapshot->fValue)
+            {
+               ++fErrors;
+            }
+         }
+      }
+
+   private:
+      SnapshotPointer<Snapshot>& fPointer;
+      std::atomic<int>& fErrors;
+   };
+};
+
+std::atomic<int> SnapshotPointerTest::Snapshot::sLive(0);
+
+static SnapshotPointerTest snapshotTest;
+
+
+/**
+ * A tiny class hierarchy for each of the locking policies, so that we can 
+ * check that every policy compiles and works.
+ */
+template <class LockType>
+class Locked : public FactoryBuildable<Locked<LockType>, LockType>
+{
+public:
+   virtual ~Locked() {}
+   virtual int Value() const = 0;
+};
+
+template <class LockType, int kValue>
+class LockedValue : public Locked<LockType>
+{
+public:
+   int Value() const override { return kValue; }
+};
+
+FACTORY_DATABASE_STORAGE(Locked<SpinLock>::Database)
+FACTORY_DATABASE_STORAGE(Locked<CriticalSection>::Database)
+FACTORY_DATABASE_STORAGE(Locked<ReadWriteLock>::Database)
+FACTORY_DATABASE_STORAGE(Locked<ReaderOptimisedLock>::Database)
+
+static Factory<Locked<SpinLock>, LockedValue<SpinLock, 1> > spinOne("one");
+static Factory<Locked<SpinLock>, LockedValue<SpinLock, 2> > spinTwo("two");
+static Factory<Locked<CriticalSection>, LockedValue<CriticalSection, 1> > criticalSectionOne("one");
+static Factory<Locked<CriticalSection>, LockedValue<CriticalSection, 2> > criticalSectionTwo("two");
+static Factory<Locked<ReadWriteLock>, LockedValue<ReadWriteLock, 1> > readWriteOne("one");
+static Factory<Locked<ReadWriteLock>, LockedValue<ReadWriteLock, 2> > readWriteTwo("two");
+static Factory<Locked<ReaderOptimisedLock>, LockedValue<ReaderOptimisedLock, 1> > readerOptimisedOne("one");
+static Factory<Locked<ReaderOptimisedLock>, LockedValue<ReaderOptimisedLock, 2> > readerOptimisedTwo("two");
+
+
+/**
+ * @class LockPolicyTest
+ * @brief Exercise a FactoryDatabase using each of the locking policies, and 
+ *        register factories while other threads are creating objects.
+ */
+class LockPolicyTest : public UnitTest
+{
+public:
+   LockPolicyTest() : UnitTest("Lock Policy Tests")
+   {
+   }
+
+   void runTest() override
+   {
+      TestPolicy<SpinLock>("SpinLock");
+      TestPolicy<CriticalSection>("CriticalSection");
+      TestPolicy<ReadWriteLock>("ReadWriteLock");
+      TestPolicy<ReaderOptimisedLock>("ReaderOptimisedLock");
+
+      beginTest("registering while creating");
+      typedef Locked<ReaderOptimisedLock> Type;
+      std::atomic<int> errors(0);
+      OwnedArray<Creator> creators;
+      for (int i = 0; i < 4; ++i)
+      {
+         creators.add(new Creator(errors))->startThread();
+      }
+      static OwnedArray<BaseFactory<Type> > extras;
+      for (int i = 0; i < 20; ++i)
+      {
+         const String name("extra" + String(i));
+         extras.add(new Factory<Type, LockedValue<ReaderOptimisedLock, 3> >(name));
+         ScopedPointer<Type> extra = Type::Create(name);
+         expect(nullptr != extra);
+         if (5 == i)
+         {
+            expect(Type::Database::Freeze());
+         }
+      }
+      creators.clear();
+      expect(0 == errors.load());
+      Type::Database::Thaw();
+
+      beginTest("thread cache");
+      TestThreadCache();
+   }
+
+private:
+   template <class LockType>
+   void TestPolicy(const String& name)
+   {
+      typedef Locked<LockType> Type;
+      beginTest(name);
+      ScopedPointer<Type> one = Type::Create("one");
+      expect(nullptr != one && 1 == one->Value());
+      expect(nullptr == Type::Create("imaginary"));
+
+      // registering while frozen rebuilds the table under the write lock,
+      // which mustn't try to take the (maybe non-reentrant) lock again.
+      expect(Type::Database::Freeze());
+      ScopedPointer<Type> two = Type::Create("two");
+      expect(nullptr != two && 2 == two->Value());
+      static Factory<Type, LockedValue<LockType, 3> > late("three");
+      ScopedPointer<Type> three = Type::Create("three");
+      expect(nullptr != three && 3 == three->Value());
+
+      Type::Database::Thaw();
+      three = Type::Create("three");
+      expect(nullptr != three && 3 == three->Value());
+   }
+
+   void TestThreadCache()
+   {
+      typedef Locked<CriticalSection> Type;
+      Type::Database::EnableThreadCache(true);
+      for (int i = 0; i < 3; ++i)
+      {
+         ScopedPointer<Type> two = Type::Create("two");
+         expect(nullptr != two && 2 == two->Value());
+         ScopedPointer<Type> one = Type::Create(TypeName("one", 3));
+         expect(nullptr != one && 1 == one->Value());
+      }
+
+      // misses aren't cached...
+      expect(nullptr == Type::Create("four"));
+      static Factory<Type, LockedValue<CriticalSection, 4> > four("four");
+      ScopedPointer<Type> obj = Type::Create("four");
+      expect(nullptr != obj && 4 == obj->Value());
+
+      // ...and registering a new factory for a cached name replaces it.
+      static Factory<Type, LockedValue<CriticalSection, 5> > five("two");
+      obj = Type::Create("two");
+      expect(nullptr != obj && 5 == obj->Value());
+
+      Type::Database::EnableThreadCache(false);
+   }
+
+   class Creator : public Thread
+   {
+   public:
+      explicit Creator(std::atomic<int>& errors)
+      :  Thread("creator")
+      ,  fErrors(errors)
+      {
+      }
+
+      ~Creator()
+      {
+         stopThread(5000);
+      }
+
+      void run() override
+      {
+         while (! threadShouldExit())
+         {
+            ScopedPointer<Locked<ReaderOptimisedLock> > one = 
+               Locked<ReaderOptimisedLock>::Create("one");
+            if (nullptr == one || 1 != one->Value())
+            {
+               ++fErrors;
+            }
+         }
+      }
+
+   private:
+      std::atomic<int>& fErrors;
+   };
+};
+
+static LockPolicyTest lockPolicyTest;
+
+
+/**
+ * A Unity that hangs on to whatever a DependencyContainer gives it. It's 
+ * registered under several names to stand in for different services.
+ */
+class Service : public Unity
+{
+public:
+   Service() { ++sLive; }
+
+   explicit Service(const Dependencies<Base>& dependencies)
+   {
+      for (int i = 0; i < dependencies.size(); ++i)
+      {
+         fDependencies.add(dependencies[i]);
+      }
+      ++sLive;
+   }
+
+   ~Service() { --sLive; }
+
+   Array<Base*> fDependencies;
+   static int sLive;
+};
+
+int Service::sLive = 0;
+
+typedef Factory<Base, Service, const Dependencies<Base>&> ServiceFactory;
+static ServiceFactory loggerFactory("di.logger");
+static ServiceFactory sessionFactory("di.session");
+static ServiceFactory handlerFactory("di.handler");
+static ServiceFactory requestIdFactory("di.requestId");
+static ServiceFactory cyclicFactory("di.cyclic");
+
+
+/**
+ * @class DependencyContainerTest
+ * @brief Check that a DependencyContainer creates each lifetime correctly, 
+ *        and refuses to compile broken registrations.
+ */
+class DependencyContainerTest : public UnitTest
+{
+public:
+   typedef DependencyContainer<Base> Container;
+
+   DependencyContainerTest() : UnitTest("Dependency Container Tests")
+   {
+   }
+
+   void runTest() override
+   {
+      beginTest("lifetimes");
+      {
+         Container container;
+         expect(container.Register("di.logger", Container::kSingleton));
+         expect(container.Register("di.requestId", Container::kTransient));
+         expect(container.Register("di.session", Container::kScoped, 
+            { "di.logger", "di.requestId" }));
+         expect(container.Register("di.handler", Container::kScoped, 
+            { "di.session", "di.logger", "di.requestId", "di.session" }));
+         expect(! container.Register("di.logger", Container::kScoped));
+         expect(nullptr == container.Resolve("di.handler"));
+
+         const int live = Service::sLive;
+         expect(container.Compile());
+         // just the singleton.
+         expect(live + 1 == Service::sLive);
+         expect(nullptr == container.Resolve("imaginary"));
+
+         const Container::Plan* handlerPlan = container.Resolve("di.handler");
+         expect(nullptr != handlerPlan);
+         // logger, request id, session, another request id, handler.
+         expect(5 == handlerPlan->GetNumSteps());
+
+         Base* logger = nullptr;
+         Base* session = nullptr;
+         {
+            Container::Scope scope(*handlerPlan);
+            expect(live + 5 == Service::sLive);
+            Service* handler = dynamic_cast<Service*>(scope.GetRoot());
+            expect(handler->GetTypeName() == "di.handler");
+            expect(4 == handler->fDependencies.size());
+            session = handler->fDependencies[0];
+            logger = handler->fDependencies[1];
+            expect(session->GetTypeName() == "di.session");
+            expect(logger->GetTypeName() == "di.logger");
+            // scoped objects are shared within the scope...
+            expect(session == handler->fDependencies[3]);
+            // ...transient ones aren't.
+            Service* sessionService = dynamic_cast<Service*>(session);
+            expect(logger == sessionService->fDependencies[0]);
+            expect(handler->fDependencies[2] != sessionService->fDependencies[1]);
+         }
+         expect(live + 1 == Service::sLive);
+
+         {
+            Container::Scope scope(*handlerPlan);
+            Service* handler = dynamic_cast<Service*>(scope.GetRoot());
+            // the same singleton in every scope.
+            expect(logger == handler->fDependencies[1]);
+
+            Container::Scope loggerScope(*container.Resolve("di.logger"));
+            expect(logger == loggerScope.GetRoot());
+         }
+         expect(live + 1 == Service::sLive);
+
+         {
+            // compiling again leaves the plans and singletons in use alone.
+            Container::Scope scope(*handlerPlan);
+            expect(container.Compile());
+            expect(handlerPlan == container.Resolve("di.handler"));
+            expect(live + 5 == Service::sLive);
+            Service* handler = dynamic_cast<Service*>(scope.GetRoot());
+            expect(logger == handler->fDependencies[1]);
+            expect(logger->GetTypeName() == "di.logger");
+         }
+         expect(live + 1 == Service::sLive);
+      }
+      expect(0 == Service::sLive);
+
+      beginTest("broken registrations");
+      {
+         Container unknown;
+         unknown.Register("di.session", Container::kScoped, { "imaginary" });
+         expect(! unknown.Compile());
+
+         Container cycle;
+         cycle.Register("di.cyclic", Container::kScoped, { "di.session" });
+         cycle.Register("di.session", Container::kTransient, { "di.cyclic" });
+         expect(! cycle.Compile());
+         expect(nullptr == cycle.Resolve("di.cyclic"));
+
+         Container captive;
+         captive.Register("di.logger", Container::kSingleton, { "di.session" });
+         captive.Register("di.session", Container::kScoped);
+         expect(! captive.Compile());
+
+         // ...or through a transient, which would be created with it.
+         Container indirect;
+         indirect.Register("di.logger", Container::kSingleton, { "di.requestId" });
+         indirect.Register("di.requestId", Container::kTransient, { "di.session" });
+         indirect.Register("di.session", Container::kScoped);
+         expect(! indirect.Compile());
+         expect(0 == Service::sLive);
+
+         // a singleton can still depend on another singleton that 
+         // uses transients.
+         {
+            Container allowed;
+            allowed.Register("di.logger", Container::kSingleton, { "di.handler" });
+            allowed.Register("di.handler", Container::kSingleton, { "di.requestId" });
+            allowed.Register("di.requestId", Container::kTransient);
+            expect(allowed.Compile());
+         }
+
+         // 'smaller' can't be constructed from its dependencies.
+         Container notInjectable;
+         notInjectable.Register("di.logger", Container::kSingleton);
+         notInjectable.Register("smaller", Container::kScoped, { "di.logger" });
+         expect(! notInjectable.Compile());
+         expect(0 == Service::sLive);
+
+         // 'sized' can't be constructed from nothing either.
+         Container needsArguments;
+         needsArguments.Register("sized", Container::kScoped);
+         expect(! needsArguments.Compile());
+
+         // ...but it can be a dependency.
+         Container plain;
+         plain.Register("smaller", Container::kScoped);
+         plain.Register("di.handler", Container::kScoped, { "smaller" });
+         expect(plain.Compile());
+         Container::Scope scope(*plain.Resolve("di.handler"));
+         Service* handler = dynamic_cast<Service*>(scope.GetRoot());
+         expect(99 == handler->fDependencies[0]->SomeIntOperation(100));
+      }
+   }
+};
+
+static DependencyContainerTest dependencyContainerTest;
+
 //==============================================================================
 int main (int argc, char* argv[])
 {
 
+   const StringArray args(argv + 1, argc - 1);
+   if (args.contains("--benchmark"))
+   {
+      RunBenchmarks();
+      return 0;
+   }
+
    // for demo purposes, just run unit tests and exit the app.
    UnitTestRunner testRunner;
    testRunner.runAllTests();
+   // the asynchronous creation tests use the message thread.
+   MessageManager::deleteInstance();
     
 
     return 0;
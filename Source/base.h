@@ -32,7 +32,7 @@
  * @brief A simple demo class for the class factory system. 
  *
  * The 3 methods:
- * - `SetTypeName()``
+ * - `SetDescriptor()`
  * - `RegisterFactory()`
  * - `Create()` 
  *
@@ -43,7 +43,8 @@ class Base : public FactoryBuildable<Base>
 {
 public:
    /**
-    * The classes created by our factory need to be default-constructable.
+    * The classes created by our factory need to be default-constructable, 
+    * and copyable if they're going to be cloned.
     */
    Base();
    
@@ -73,10 +74,8 @@ public:
    ///@}
 
 private:
-
-   String fTypeName;
-   
-   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Base)
+   // copyable, so that objects can be cloned.
+   JUCE_LEAK_DETECTOR(Base)
 };
 
 
@@ -25,7 +25,7 @@
 
 
 // This source file only exists as a place to park the storage for the
-// two static data fields used in the BaseFactoryDatabase class.
+// static data fields used in the BaseFactoryDatabase class, including the 
+// bounds of the `cf_base` section that FACTORY_RECORD() puts records in.
 
-template<> int BaseFactoryDatabase::fCount = 0;
-template<> BaseFactoryDb* BaseFactoryDatabase::fDatabase = nullptr;
+FACTORY_DATABASE_STORAGE_WITH_RECORDS(BaseFactoryDatabase, cf_base)
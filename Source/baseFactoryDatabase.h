@@ -24,15 +24,10 @@
 #ifndef BASEFACTORYDATABASE_H_INCLUDED
 #define BASEFACTORYDATABASE_H_INCLUDED
 
-#include "factoryDatabase.h"
-
-class Base;
-
-using BaseFactoryDb = HashMap<String, BaseFactory<Base>*>;
-using BaseFactoryDatabase = FactoryDatabase<Base>;
-
-static BaseFactoryDatabase bfd;
+#include "base.h"
 
+using BaseFactoryDatabase = Base::Database;
+using BaseFactoryDb = BaseFactoryDatabase::Map;
 
 
 
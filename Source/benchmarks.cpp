@@ -0,0 +1,969 @@
+/*
+ * Copyright (c) 2016 Brett g Porter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above
+ * copyright notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS",
+ * WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "benchmarks.h"
+#include "derived.h"
+#include "baseFactoryDatabase.h"
+#include "configSchema.h"
+#include "dependencyContainer.h"
+#include "factoryRecord.h"
+#include "pooledFactory.h"
+#include "polyValue.h"
+
+#include <functional>
+
+
+namespace
+{
+   /**
+    * Class hierarchies of their own for the startup benchmark, so that it 
+    * can register a thousand types in each without disturbing Base: every 
+    * Plugin type is recorded, and every StaticPlugin type has a Factory 
+    * object.
+    */
+   class Plugin : public FactoryBuildable<Plugin>
+   {
+   public:
+      virtual int GetId() const = 0;
+   };
+
+   template <int kId>
+   class PluginType : public Plugin
+   {
+   public:
+      int GetId() const override { return kId; }
+   };
+
+   class StaticPlugin : public FactoryBuildable<StaticPlugin>
+   {
+
+   };
+
+   typedef Plugin::Database PluginDatabase;
+   typedef StaticPlugin::Database StaticPluginDatabase;
+
+   const int kNumStartupTypes = 1000;
+}
+
+FACTORY_DATABASE_STORAGE_WITH_RECORDS(PluginDatabase, cf_benchmark_plugin)
+FACTORY_DATABASE_STORAGE(StaticPluginDatabase)
+
+// Startup costs are measured as the program starts: static initialization
+// runs in the order of the declarations in a file, so the time taken before
+// and after a block of declarations brackets what that block costs. Each 
+// block declares kNumStartupTypes types numbered from a __COUNTER__ value.
+#define BENCHMARK_EXPAND(m, n) m(n)
+#define BENCHMARK_NEXT(m) BENCHMARK_EXPAND(m, __COUNTER__)
+#define BENCHMARK_X10(m) BENCHMARK_NEXT(m) BENCHMARK_NEXT(m) BENCHMARK_NEXT(m) \
+   BENCHMARK_NEXT(m) BENCHMARK_NEXT(m) BENCHMARK_NEXT(m) BENCHMARK_NEXT(m) \
+   BENCHMARK_NEXT(m) BENCHMARK_NEXT(m) BENCHMARK_NEXT(m)
+#define BENCHMARK_X100(m) BENCHMARK_X10(m) BENCHMARK_X10(m) BENCHMARK_X10(m) \
+   BENCHMARK_X10(m) BENCHMARK_X10(m) BENCHMARK_X10(m) BENCHMARK_X10(m) \
+   BENCHMARK_X10(m) BENCHMARK_X10(m) BENCHMARK_X10(m)
+#define BENCHMARK_X1000(m) BENCHMARK_X100(m) BENCHMARK_X100(m) BENCHMARK_X100(m) \
+   BENCHMARK_X100(m) BENCHMARK_X100(m) BENCHMARK_X100(m) BENCHMARK_X100(m) \
+   BENCHMARK_X100(m) BENCHMARK_X100(m) BENCHMARK_X100(m)
+
+#define BENCHMARK_RECORDED_PLUGIN(n) \
+   FACTORY_RECORD_WITH_ID(n, cf_benchmark_plugin, Plugin, \
+      TypeName("plugin.recorded." JUCE_STRINGIFY(n)), Factory<Plugin, PluginType<0> >);
+
+#define BENCHMARK_STATIC_PLUGIN(n) \
+   Factory<StaticPlugin, StaticPlugin> JUCE_JOIN_MACRO(staticPlugin, n)( \
+      "plugin.static." JUCE_STRINGIFY(n));
+
+namespace
+{
+   const int64 sRecordsStart = Time::getHighResolutionTicks();
+   enum { kFirstRecordedPlugin = __COUNTER__ + 1 };
+}
+
+BENCHMARK_X1000(BENCHMARK_RECORDED_PLUGIN)
+
+namespace
+{
+   const int64 sRecordsEnd = Time::getHighResolutionTicks();
+
+#if ! JUCE_DEBUG
+   // only in Release builds, where registering doesn't log anything, so 
+   // that Debug builds (and the tests) don't start up with a thousand 
+   // lines of logging.
+   const int64 sFactoriesStart = Time::getHighResolutionTicks();
+   enum { kFirstStaticPlugin = __COUNTER__ + 1 };
+
+   BENCHMARK_X1000(BENCHMARK_STATIC_PLUGIN)
+
+   const int64 sFactoriesEnd = Time::getHighResolutionTicks();
+#endif
+}
+
+
+namespace
+{
+   /// The type names that we cycle through when creating objects.
+   const char* const kTypeNames[] = { "unity", "smaller", "bigger" };
+   const int kNumTypeNames = numElementsInArray(kTypeNames);
+
+   /// Base's own types are all recorded, so lookups of their names never 
+   /// reach the HashMap, the frozen table or the thread cache. The 
+   /// benchmarks of those use the same types registered under these names.
+   const char* const kRegisteredNames[] = { "benchmark.registered.unity", 
+      "benchmark.registered.smaller", "benchmark.registered.bigger" };
+
+   // the benchmarks' own types are recorded rather than registered, so that
+   // they don't add anything to Base's startup.
+   FACTORY_RECORD_WITH_FACTORY(cf_base, Base, "benchmark.pooled.unity"_type, 
+      PooledFactory<Base, Unity>);
+   FACTORY_RECORD_WITH_FACTORY(cf_base, Base, "benchmark.pooled.smaller"_type, 
+      PooledFactory<Base, Smaller>);
+   FACTORY_RECORD_WITH_FACTORY(cf_base, Base, "benchmark.pooled.bigger"_type, 
+      PooledFactory<Base, Bigger>);
+
+   /**
+    * A Unity with a buffer, which is either sized after it's created or 
+    * when it's constructed.
+    */
+   class Reserved : public Unity
+   {
+   public:
+      Reserved() : Reserved(8) {}
+      explicit Reserved(int size) { fValues.ensureStorageAllocated(size); }
+
+      void Reserve(int size) { fValues.ensureStorageAllocated(size); }
+
+      Array<int> fValues;
+   };
+
+   FACTORY_RECORD_WITH_FACTORY(cf_base, Base, "benchmark.reserved"_type, 
+      Factory<Base, Reserved, int>);
+
+   /**
+    * Unities that read a handful of properties from their config, either 
+    * through a ConfigSchema or by name.
+    */
+   class SchemaConfigured : public Unity
+   {
+   public:
+      void Configure(const ValueTree& config) override
+      {
+         enum { kWidth, kHeight, kDepth, kGain, kName };
+         static const ConfigSchema schema { "width", "height", "depth", "gain", "name" };
+         fSum = static_cast<int>(schema.Get(config, kWidth)) 
+            + static_cast<int>(schema.Get(config, kHeight))
+            + static_cast<int>(schema.Get(config, kDepth))
+            + static_cast<int>(static_cast<double>(schema.Get(config, kGain)));
+         fName = schema.Get(config, kName).toString();
+      }
+
+      int fSum;
+      String fName;
+   };
+
+   class NameConfigured : public SchemaConfigured
+   {
+   public:
+      void Configure(const ValueTree& config) override
+      {
+         fSum = static_cast<int>(config["width"]) 
+            + static_cast<int>(config["height"])
+            + static_cast<int>(config["depth"])
+            + static_cast<int>(static_cast<double>(config["gain"]));
+         fName = config["name"].toString();
+      }
+   };
+
+   FACTORY_RECORD(cf_base, Base, SchemaConfigured, "benchmark.configured.schema"_type);
+   FACTORY_RECORD(cf_base, Base, NameConfigured, "benchmark.configured.names"_type);
+
+   /**
+    * A Unity that keeps the dependencies that it's constructed with.
+    */
+   class Component : public Unity
+   {
+   public:
+      explicit Component(const Dependencies<Base>& dependencies)
+      {
+         for (int i = 0; i < dependencies.size(); ++i)
+         {
+            fDependencies[i] = dependencies[i];
+         }
+      }
+
+      Base* fDependencies[4];
+   };
+
+   /**
+    * A Unity that builds a table in its constructor, standing in for types 
+    * that load resources when they're created.
+    */
+   class Loading : public Unity
+   {
+   public:
+      Loading()
+      {
+         fTable.resize(65536);
+         for (int i = 0; i < fTable.size(); ++i)
+         {
+            fTable.set(i, std::sin(i * 0.001f));
+         }
+      }
+
+      Array<float> fTable;
+   };
+
+   FACTORY_RECORD(cf_base, Base, Loading, "benchmark.loading"_type);
+
+   typedef Factory<Base, Component, const Dependencies<Base>&> ComponentFactory;
+   FACTORY_RECORD_WITH_FACTORY(cf_base, Base, "benchmark.di.logger"_type, ComponentFactory);
+   FACTORY_RECORD_WITH_FACTORY(cf_base, Base, "benchmark.di.config"_type, ComponentFactory);
+   FACTORY_RECORD_WITH_FACTORY(cf_base, Base, "benchmark.di.database"_type, ComponentFactory);
+   FACTORY_RECORD_WITH_FACTORY(cf_base, Base, "benchmark.di.cache"_type, ComponentFactory);
+   FACTORY_RECORD_WITH_FACTORY(cf_base, Base, "benchmark.di.requestId"_type, ComponentFactory);
+   FACTORY_RECORD_WITH_FACTORY(cf_base, Base, "benchmark.di.session"_type, ComponentFactory);
+   FACTORY_RECORD_WITH_FACTORY(cf_base, Base, "benchmark.di.handler"_type, ComponentFactory);
+
+   /**
+    * Log the average time taken by `iterations` operations that took 
+    * `ticks` high resolution ticks altogether.
+    */
+   void LogElapsed(const String& label, int iterations, int64 ticks)
+   {
+      const double elapsed = Time::highResolutionTicksToSeconds(ticks);
+      Logger::writeToLog(label.paddedRight(' ', 48) 
+         + String(elapsed * 1.0e9 / iterations, 1) + " ns/op");
+   }
+
+   /**
+    * Time `iterations` calls to a function and log the average time per call.
+    * @param label      Description of what's being measured.
+    * @param iterations Number of times to call the function.
+    * @param fn         Function/lambda taking the iteration index.
+    */
+   template <typename Fn>
+   void Measure(const String& label, int iterations, Fn fn)
+   {
+      const int64 start = Time::getHighResolutionTicks();
+      for (int i = 0; i < iterations; ++i)
+      {
+         fn(i);
+      }
+      LogElapsed(label, iterations, Time::getHighResolutionTicks() - start);
+   }
+
+
+   /**
+    * @class BenchmarkThread
+    * @brief Runs a function on its own thread.
+    */
+   class BenchmarkThread : public Thread
+   {
+   public:
+      explicit BenchmarkThread(std::function<void()> body)
+      :  Thread("benchmark")
+      ,  fBody(body)
+      {
+
+      }
+
+      ~BenchmarkThread()
+      {
+         stopThread(10000);
+      }
+
+      void run() override
+      {
+         fBody();
+      }
+
+   private:
+      std::function<void()> fBody;
+   };
+
+
+   /**
+    * Time `numThreads` threads each calling `fn` `iterations` times, while 
+    * another thread calls `background` over and over until they finish.
+    * @return total calls per second across all of the threads.
+    */
+   double MeasureThroughput(int numThreads, int iterations, 
+      std::function<void(int)> fn, std::function<void()> background)
+   {
+      std::atomic<bool> done(false);
+      BenchmarkThread backgroundThread([&done, &background] ()
+      {
+         while (! done.load())
+         {
+            background();
+            Thread::sleep(1);
+         }
+      });
+      backgroundThread.startThread();
+
+      OwnedArray<BenchmarkThread> workers;
+      for (int t = 0; t < numThreads; ++t)
+      {
+         workers.add(new BenchmarkThread([iterations, &fn] ()
+         {
+            for (int i = 0; i < iterations; ++i)
+            {
+               fn(i);
+            }
+         }));
+      }
+
+      const int64 start = Time::getHighResolutionTicks();
+      for (BenchmarkThread* w : workers)
+      {
+         w->startThread();
+      }
+      for (BenchmarkThread* w : workers)
+      {
+         w->waitForThreadToExit(-1);
+      }
+      const double elapsed = Time::highResolutionTicksToSeconds(
+         Time::getHighResolutionTicks() - start);
+      done.store(true);
+
+      return (static_cast<double>(numThreads) * iterations) / elapsed;
+   }
+
+
+   /**
+    * Compare creating objects by name with creating them through handles
+    * that were resolved ahead of time.
+    */
+   void CreateByNameVsHandle()
+   {
+      const int kIterations = 2000000;
+
+      Measure("Create(name)", kIterations, [] (int i)
+      {
+         ScopedPointer<Base> obj = Base::Create(kRegisteredNames[i % kNumTypeNames]);
+      });
+      Measure("Create(name), FactoryRecord", kIterations, [] (int i)
+      {
+         ScopedPointer<Base> obj = Base::Create(kTypeNames[i % kNumTypeNames]);
+      });
+
+      FactoryHandle<Base> handles[kNumTypeNames];
+      for (int i = 0; i < kNumTypeNames; ++i)
+      {
+         handles[i] = Base::Resolve(kTypeNames[i]);
+      }
+
+      Measure("Create(handle)", kIterations, [&handles] (int i)
+      {
+         ScopedPointer<Base> obj = Base::Create(handles[i % kNumTypeNames]);
+      });
+
+      FactoryHandle<Base> pooledHandles[kNumTypeNames];
+      for (int i = 0; i < kNumTypeNames; ++i)
+      {
+         pooledHandles[i] = Base::Resolve("benchmark.pooled." + String(kTypeNames[i]));
+      }
+
+      Measure("Create(handle), pooled", kIterations, [&pooledHandles] (int i)
+      {
+         ScopedPointer<Base> obj = Base::Create(pooledHandles[i % kNumTypeNames]);
+      });
+
+      Measure("CreateUnique(handle), pooled", kIterations, [&pooledHandles] (int i)
+      {
+         FactoryPtr<Base> obj = Base::CreateUnique(pooledHandles[i % kNumTypeNames]);
+      });
+
+      Base::SetRecycling("smaller", 16);
+      Measure("CreateUnique(handle), recycled", kIterations, [&handles] (int)
+      {
+         FactoryPtr<Base> obj = Base::CreateUnique(handles[1]);
+      });
+      Base::SetRecycling("smaller", 0);
+      Base::DiscardPrewarmed("smaller");
+
+      alignas(std::max_align_t) char buffer[256];
+      Measure("CreateAt(handle)", kIterations, [&handles, &buffer] (int i)
+      {
+         Base* obj = Base::CreateAt(handles[i % kNumTypeNames], buffer);
+         obj->~Base();
+      });
+
+      const int kBatchSize = 10000;
+      Measure("Create(name) x 10000", kIterations / kBatchSize, [] (int)
+      {
+         OwnedArray<Base> objects;
+         objects.ensureStorageAllocated(kBatchSize);
+         for (int i = 0; i < kBatchSize; ++i)
+         {
+            objects.add(Base::Create("smaller"));
+         }
+      });
+      Measure("CreateBatch(name, 10000)", kIterations / kBatchSize, [] (int)
+      {
+         FactoryBatch<Base> batch = Base::CreateBatch("smaller", kBatchSize);
+      });
+
+      {
+         const int kNumWarm = kIterations / 10;
+         ThreadPool pool(2);
+         Base::Prewarm("smaller", kNumWarm, pool);
+         while (pool.getNumJobs() > 0)
+         {
+            Thread::sleep(1);
+         }
+         OwnedArray<Base> objects;
+         objects.ensureStorageAllocated(kNumWarm);
+         Measure("Create(handle), prewarmed", kNumWarm, [&handles, &objects] (int)
+         {
+            objects.add(Base::Create(handles[1]));
+         });
+         objects.clear();
+         Measure("Create(handle), cold", kNumWarm, [&handles, &objects] (int)
+         {
+            objects.add(Base::Create(handles[1]));
+         });
+      }
+
+      ObjectArena arena;
+      Measure("Create(handle), arena", kIterations, [&handles, &arena] (int i)
+      {
+         Base::Create(handles[i % kNumTypeNames], arena);
+         if (0 == (i + 1) % 1000)
+         {
+            arena.Reset();
+         }
+      });
+      arena.Reset();
+
+      Measure("PolyValue(handle)", kIterations, [&handles] (int i)
+      {
+         PolyValue<Base> value(handles[i % kNumTypeNames]);
+      });
+      Measure("PolyValue(handle) x 10000, vector", kIterations / kBatchSize, 
+         [&handles] (int)
+      {
+         std::vector<PolyValue<Base> > values;
+         values.reserve(kBatchSize);
+         for (int i = 0; i < kBatchSize; ++i)
+         {
+            values.emplace_back(handles[i % kNumTypeNames]);
+         }
+      });
+      Measure("Create(handle) x 10000, OwnedArray", kIterations / kBatchSize, 
+         [&handles] (int)
+      {
+         OwnedArray<Base> objects;
+         objects.ensureStorageAllocated(kBatchSize);
+         for (int i = 0; i < kBatchSize; ++i)
+         {
+            objects.add(Base::Create(handles[i % kNumTypeNames]));
+         }
+      });
+
+      const FactoryHandle<Base> reserved = Base::Resolve("benchmark.reserved");
+      Measure("Create(handle), then set up", kIterations, [&reserved] (int)
+      {
+         ScopedPointer<Base> obj = Base::Create(reserved);
+         static_cast<Reserved*>(obj.get())->Reserve(64);
+      });
+      Measure("CreateWith<int>(handle)", kIterations, [&reserved] (int)
+      {
+         ScopedPointer<Base> obj = Base::CreateWith<int>(reserved, 64);
+      });
+
+      ScopedPointer<Base> originals[kNumTypeNames];
+      for (int i = 0; i < kNumTypeNames; ++i)
+      {
+         originals[i] = Base::Create(kTypeNames[i]);
+      }
+      Measure("Create(GetTypeName())", kIterations, [&originals] (int i)
+      {
+         ScopedPointer<Base> obj = Base::Create(originals[i % kNumTypeNames]->GetTypeName());
+      });
+      Measure("CloneSameType()", kIterations, [&originals] (int i)
+      {
+         ScopedPointer<Base> obj = originals[i % kNumTypeNames]->CloneSameType();
+      });
+
+      BaseFactoryDatabase::EnableThreadCache(true);
+      Measure("Create(name), thread cache", kIterations, [] (int i)
+      {
+         ScopedPointer<Base> obj = Base::Create(kRegisteredNames[i % kNumTypeNames]);
+      });
+      BaseFactoryDatabase::EnableThreadCache(false);
+   }
+
+
+   /**
+    * Compare creating objects from config trees, reading their properties 
+    * through a ConfigSchema and by name.
+    */
+   void CreateFromConfig()
+   {
+      const int kIterations = 500000;
+      const int kNumConfigs = 64;
+      Array<ValueTree> schemaConfigs;
+      Array<ValueTree> nameConfigs;
+      for (int i = 0; i < kNumConfigs; ++i)
+      {
+         ValueTree config("node");
+         config.setProperty("type", "benchmark.configured.schema", nullptr);
+         config.setProperty("width", i, nullptr);
+         config.setProperty("height", i * 2, nullptr);
+         config.setProperty("depth", i * 3, nullptr);
+         config.setProperty("gain", 0.5 * i, nullptr);
+         config.setProperty("name", "node " + String(i), nullptr);
+         schemaConfigs.add(config);
+         ValueTree named = config.createCopy();
+         named.setProperty("type", "benchmark.configured.names", nullptr);
+         nameConfigs.add(named);
+      }
+
+      Measure("Create(ValueTree), property names", kIterations, [&nameConfigs] (int i)
+      {
+         ScopedPointer<Base> obj = Base::Create(nameConfigs.getReference(i % kNumConfigs));
+      });
+      Measure("Create(ValueTree), ConfigSchema", kIterations, [&schemaConfigs] (int i)
+      {
+         ScopedPointer<Base> obj = Base::Create(schemaConfigs.getReference(i % kNumConfigs));
+      });
+   }
+
+
+   /**
+    * Compare wiring up a request scope's components by hand, looking each 
+    * one up by name, with running a DependencyContainer's plan.
+    */
+   void DependencyScopes()
+   {
+      const int kIterations = 200000;
+      typedef DependencyContainer<Base> Container;
+      typedef const Dependencies<Base>& Deps;
+
+      Container container;
+      container.Register("benchmark.di.logger", Container::kSingleton);
+      container.Register("benchmark.di.config", Container::kScoped);
+      container.Register("benchmark.di.database", Container::kScoped, 
+         { "benchmark.di.config", "benchmark.di.logger" });
+      container.Register("benchmark.di.cache", Container::kScoped, 
+         { "benchmark.di.database", "benchmark.di.logger" });
+      container.Register("benchmark.di.requestId", Container::kTransient);
+      container.Register("benchmark.di.session", Container::kScoped, 
+         { "benchmark.di.config", "benchmark.di.logger", "benchmark.di.requestId" });
+      container.Register("benchmark.di.handler", Container::kScoped, 
+         { "benchmark.di.session", "benchmark.di.cache", "benchmark.di.database", 
+         "benchmark.di.requestId" });
+      container.Compile();
+      const Container::Plan* plan = container.Resolve("benchmark.di.handler");
+      Base* const logger = Container::Scope(*container.Resolve("benchmark.di.logger")).GetRoot();
+
+      Measure("request scope, wired by name", kIterations, [logger] (int)
+      {
+         Base* none = nullptr;
+         ScopedPointer<Base> config = Base::CreateWith<Deps>("benchmark.di.config", 
+            Dependencies<Base>(&none, 0));
+         Base* databaseArgs[] = { config, logger };
+         ScopedPointer<Base> database = Base::CreateWith<Deps>("benchmark.di.database", 
+            Dependencies<Base>(databaseArgs, 2));
+         Base* cacheArgs[] = { database, logger };
+         ScopedPointer<Base> cache = Base::CreateWith<Deps>("benchmark.di.cache", 
+            Dependencies<Base>(cacheArgs, 2));
+         ScopedPointer<Base> sessionId = Base::CreateWith<Deps>("benchmark.di.requestId", 
+            Dependencies<Base>(&none, 0));
+         Base* sessionArgs[] = { config, logger, sessionId };
+         ScopedPointer<Base> session = Base::CreateWith<Deps>("benchmark.di.session", 
+            Dependencies<Base>(sessionArgs, 3));
+         ScopedPointer<Base> handlerId = Base::CreateWith<Deps>("benchmark.di.requestId", 
+            Dependencies<Base>(&none, 0));
+         Base* handlerArgs[] = { session, cache, database, handlerId };
+         ScopedPointer<Base> handler = Base::CreateWith<Deps>("benchmark.di.handler", 
+            Dependencies<Base>(handlerArgs, 4));
+      });
+      Measure("request scope, DependencyContainer plan", kIterations, [plan] (int)
+      {
+         Container::Scope scope(*plan);
+      });
+   }
+
+
+   /**
+    * Compare how long a thread is blocked creating slow objects itself with 
+    * handing them to a thread pool.
+    */
+   void CreateAsyncLatency()
+   {
+      const int kIterations = 200;
+      const FactoryHandle<Base> loading = Base::Resolve("benchmark.loading");
+      Measure("Create(handle), slow constructor", kIterations, [&loading] (int)
+      {
+         ScopedPointer<Base> obj = Base::Create(loading);
+      });
+
+      ThreadPool pool(2);
+      std::atomic<int> numCreated(0);
+      Measure("CreateAsync(handle), caller's time", kIterations, 
+         [&loading, &pool, &numCreated] (int)
+      {
+         Base::CreateAsync(loading, ValueTree(), pool, [&numCreated] (FactoryPtr<Base>)
+         {
+            ++numCreated;
+         });
+      });
+      while (numCreated < kIterations)
+      {
+         Thread::sleep(1);
+      }
+   }
+
+
+   /**
+    * Compare creating a long list of mixed types one at a time with 
+    * `CreateMany()`.
+    */
+   void CreateManyScaling()
+   {
+      const int kNumObjects = 50000;
+      const int kIterations = 20;
+      StringArray names;
+      for (int i = 0; i < kNumObjects; ++i)
+      {
+         names.add(kTypeNames[(i * 7) % kNumTypeNames]);
+      }
+
+      Measure("Create(name) x 50000", kIterations, [&names] (int)
+      {
+         std::vector<FactoryPtr<Base> > objects;
+         objects.reserve(names.size());
+         for (const String& name : names)
+         {
+            objects.push_back(Base::CreateUnique(name));
+         }
+      });
+
+      for (int numThreads = 1; numThreads <= jmax(4, SystemStats::getNumCpus()); numThreads *= 2)
+      {
+         ThreadPool pool(numThreads);
+         Measure("CreateMany(50000), " + String(numThreads) + " pool threads", kIterations, 
+            [&names, &pool] (int)
+         {
+            std::vector<FactoryPtr<Base> > objects = Base::CreateMany(names, pool);
+         });
+      }
+   }
+
+
+   /**
+    * Compare what registering types costs at startup: a Factory object per 
+    * type registers itself during static initialization, while a 
+    * FactoryRecord is constant data that costs nothing until the first 
+    * lookup in its hierarchy builds the hierarchy's record index. The static
+    * initialization of both was timed as the program started.
+    */
+   void StartupRegistration()
+   {
+      const int kNumTypes = 2000;
+      StringArray names;
+      for (int i = 0; i < kNumTypes; ++i)
+      {
+         names.add("plugin.dynamic." + String(i));
+      }
+
+      StringArray recordedNames;
+      for (int i = 0; i < kNumStartupTypes; ++i)
+      {
+         recordedNames.add("plugin.recorded." + String(kFirstRecordedPlugin + i));
+      }
+      LogElapsed("FactoryRecord, static initialization", kNumStartupTypes, 
+         sRecordsEnd - sRecordsStart);
+      Measure("FactoryRecord, first Create(name)", 1, [&recordedNames] (int)
+      {
+         ScopedPointer<Plugin> obj = Plugin::Create(recordedNames[0]);
+      });
+      Measure("FactoryRecord, later Create(name)", 1000000, [&recordedNames] (int i)
+      {
+         ScopedPointer<Plugin> obj = Plugin::Create(recordedNames[i % kNumStartupTypes]);
+      });
+
+#if ! JUCE_DEBUG
+      StringArray staticNames;
+      for (int i = 0; i < kNumStartupTypes; ++i)
+      {
+         staticNames.add("plugin.static." + String(kFirstStaticPlugin + i));
+      }
+      LogElapsed("Factory object, static initialization", kNumStartupTypes, 
+         sFactoriesEnd - sFactoriesStart);
+      Measure("Factory object, Create(name)", 1000000, [&staticNames] (int i)
+      {
+         ScopedPointer<StaticPlugin> obj = StaticPlugin::Create(staticNames[i % kNumStartupTypes]);
+      });
+#else
+      Logger::writeToLog(String("Factory object, static initialization").paddedRight(' ', 48)
+         + "(Release builds only)");
+#endif
+
+      // a table of records as big as a large plugin collection's, looked up 
+      // with a linear scan and through a FactoryRecordIndex.
+      Array<FactoryRecord<Plugin> > records;
+      for (const String& name : names)
+      {
+         FactoryRecord<Plugin> record = { name.toRawUTF8(), name.getNumBytesAsUTF8(), 
+            TypeNameHash::Calculate(name), nullptr };
+         records.add(record);
+      }
+      const int kLookups = 20000;
+      // keeps the lookups from being optimised away.
+      const FactoryRecord<Plugin>* volatile found = nullptr;
+      Measure("2000 records, linear scan", kLookups, [&records, &found] (int i)
+      {
+         const FactoryRecord<Plugin>& wanted = records.getReference((i % kNumTypes) * 7919 % kNumTypes);
+         for (const FactoryRecord<Plugin>& record : records)
+         {
+            if (record.hash == wanted.hash && record.length == wanted.length 
+               && 0 == memcmp(record.name, wanted.name, wanted.length))
+            {
+               found = &record;
+               break;
+            }
+         }
+      });
+      Measure("2000 records, building FactoryRecordIndex", 100, [&records] (int)
+      {
+         const FactoryRecordIndex<Plugin> index(records.begin(), records.end());
+      });
+      const FactoryRecordIndex<Plugin> index(records.begin(), records.end());
+      Measure("2000 records, FactoryRecordIndex", kLookups * 50, 
+         [&records, &index, &found] (int i)
+      {
+         const FactoryRecord<Plugin>& wanted = records.getReference((i % kNumTypes) * 7919 % kNumTypes);
+         found = index.Find(wanted.name, wanted.length, wanted.hash);
+      });
+   }
+
+
+   /**
+    * Compare name lookups in the record index with lookups of types 
+    * registered at run time, in the HashMap, the frozen perfect hash table 
+    * and the thread cache.
+    */
+   void HashMapVsFrozen()
+   {
+      const int kIterations = 5000000;
+
+      static constexpr TypeName kRegisteredTypes[] = { "benchmark.registered.unity"_type,
+         "benchmark.registered.smaller"_type, "benchmark.registered.bigger"_type };
+
+      Measure("Resolve(name), FactoryRecordIndex", kIterations, [] (int i)
+      {
+         FactoryHandle<Base> handle = Base::Resolve(kTypeNames[i % kNumTypeNames]);
+         jassert(handle.IsValid());
+         ignoreUnused(handle);
+      });
+      Measure("Resolve(TypeName), FactoryRecordIndex", kIterations, [] (int i)
+      {
+         FactoryHandle<Base> handle = Base::Resolve(BaseTypes::kAll[i % kNumTypeNames]);
+         jassert(handle.IsValid());
+         ignoreUnused(handle);
+      });
+
+      Measure("Resolve(name), HashMap", kIterations, [] (int i)
+      {
+         FactoryHandle<Base> handle = Base::Resolve(kRegisteredNames[i % kNumTypeNames]);
+         jassert(handle.IsValid());
+         ignoreUnused(handle);
+      });
+
+      BaseFactoryDatabase::Freeze();
+      Measure("Resolve(name), frozen", kIterations, [] (int i)
+      {
+         FactoryHandle<Base> handle = Base::Resolve(kRegisteredNames[i % kNumTypeNames]);
+         jassert(handle.IsValid());
+         ignoreUnused(handle);
+      });
+      Measure("Resolve(TypeName), frozen", kIterations, [] (int i)
+      {
+         FactoryHandle<Base> handle = Base::Resolve(kRegisteredTypes[i % kNumTypeNames]);
+         jassert(handle.IsValid());
+         ignoreUnused(handle);
+      });
+      Measure("Create(name), frozen", kIterations / 2, [] (int i)
+      {
+         ScopedPointer<Base> obj = Base::Create(kRegisteredNames[i % kNumTypeNames]);
+      });
+      BaseFactoryDatabase::Thaw();
+
+      BaseFactoryDatabase::EnableThreadCache(true);
+      Measure("Resolve(name), thread cache", kIterations, [] (int i)
+      {
+         FactoryHandle<Base> handle = Base::Resolve(kRegisteredNames[i % kNumTypeNames]);
+         jassert(handle.IsValid());
+         ignoreUnused(handle);
+      });
+      BaseFactoryDatabase::EnableThreadCache(false);
+
+      Measure("Create<TypeName>()", kIterations / 2, [] (int i)
+      {
+         ScopedPointer<Base> obj;
+         switch (i % kNumTypeNames)
+         {
+            case 0: obj = Base::Create<BaseTypes::kUnity>(); break;
+            case 1: obj = Base::Create<BaseTypes::kSmaller>(); break;
+            default: obj = Base::Create<BaseTypes::kBigger>(); break;
+         }
+      });
+   }
+
+
+   /**
+    * Allocation throughput as the number of threads goes up, comparing plain 
+    * new/delete with a PooledFactory (whose threads each have their own 
+    * magazine of free slots).
+    */
+   void AllocationScaling()
+   {
+      const int kIterations = 100000;
+      const int kObjectsPerIteration = 16;
+      const int maxThreads = jmax(4, SystemStats::getNumCpus());
+
+      const FactoryHandle<Base> handles[] = 
+      { 
+         Base::Resolve("smaller"), 
+         Base::Resolve("benchmark.pooled.smaller") 
+      };
+      const char* const labels[] = { "new/delete", "pooled" };
+
+      for (int h = 0; h < numElementsInArray(handles); ++h)
+      {
+         const FactoryHandle<Base> handle = handles[h];
+         for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+         {
+            const double perSecond = MeasureThroughput(numThreads, kIterations, 
+               [handle] (int)
+               {
+                  Base* objects[kObjectsPerIteration];
+                  for (Base*& obj : objects)
+                  {
+                     obj = Base::Create(handle);
+                  }
+                  for (Base* obj : objects)
+                  {
+                     delete obj;
+                  }
+               },
+               [] () {});
+
+            Logger::writeToLog(("Create+delete x 16, " + String(labels[h]) + ", " 
+               + String(numThreads) + " threads").paddedRight(' ', 48) 
+               + String(perSecond * kObjectsPerIteration / 1.0e6, 2) + " M/s");
+         }
+      }
+   }
+
+
+   /**
+    * Create() throughput as the number of threads goes up, while another 
+    * thread keeps registering factories, comparing a single CriticalSection 
+    * around all database access with the database's concurrent mode. 
+    *
+    * Note that this one leaves the database in concurrent mode, so it has to
+    * run last.
+    */
+   void ConcurrentCreateScaling()
+   {
+      const int kIterations = 200000;
+      const int kNumPlugins = 8;
+
+      // factories that the 'plugin loading' thread keeps re-registering.
+      static OwnedArray<BaseFactory<Base> > plugins;
+      for (int i = 0; i < kNumPlugins; ++i)
+      {
+         plugins.add(new Factory<Base, Unity>("plugin" + String(i)));
+      }
+      int nextPlugin = 0;
+      auto registerPlugin = [&nextPlugin] ()
+      {
+         BaseFactory<Base>* plugin = plugins[nextPlugin++ % kNumPlugins];
+         Base::RegisterFactory(plugin->GetTypeName(), plugin);
+      };
+
+      const int maxThreads = jmax(4, SystemStats::getNumCpus());
+      CriticalSection lock;
+
+      for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+      {
+         const double locked = MeasureThroughput(numThreads, kIterations, 
+            [&lock] (int i)
+            {
+               ScopedPointer<Base> obj;
+               {
+                  const ScopedLock sl(lock);
+                  obj = Base::Create(kRegisteredNames[i % kNumTypeNames]);
+               }
+            }, 
+            [&lock, &registerPlugin] ()
+            {
+               const ScopedLock sl(lock);
+               registerPlugin();
+            });
+
+         Logger::writeToLog(("Create(name), CriticalSection, " + String(numThreads) 
+            + " threads").paddedRight(' ', 48) + String(locked / 1.0e6, 2) + " M/s");
+      }
+
+      BaseFactoryDatabase::EnableConcurrentAccess();
+      for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+      {
+         const double concurrent = MeasureThroughput(numThreads, kIterations, 
+            [] (int i)
+            {
+               ScopedPointer<Base> obj = Base::Create(kRegisteredNames[i % kNumTypeNames]);
+            },
+            registerPlugin);
+
+         Logger::writeToLog(("Create(name), concurrent, " + String(numThreads) 
+            + " threads").paddedRight(' ', 48) + String(concurrent / 1.0e6, 2) + " M/s");
+      }
+   }
+}
+
+
+void RunBenchmarks()
+{
+   Logger::writeToLog("Class factory benchmarks");
+   Logger::writeToLog(String::repeatedString("-", 60));
+
+   // registered here rather than at file scope, so that they don't add 
+   // anything to startup either; they stay registered for good.
+   static Factory<Base, Unity> registeredUnity(kRegisteredNames[0]);
+   static Factory<Base, Smaller> registeredSmaller(kRegisteredNames[1]);
+   static Factory<Base, Bigger> registeredBigger(kRegisteredNames[2]);
+
+   CreateByNameVsHandle();
+   CreateFromConfig();
+   DependencyScopes();
+   CreateAsyncLatency();
+   CreateManyScaling();
+   StartupRegistration();
+   HashMapVsFrozen();
+   AllocationScaling();
+   // leaves the database in concurrent mode -- keep this last.
+   ConcurrentCreateScaling();
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2016 Brett g Porter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above
+ * copyright notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS",
+ * WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CONFIGSCHEMA_H_INCLUDED
+#define CONFIGSCHEMA_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+#include <initializer_list>
+
+/**
+ * @class ConfigSchema
+ *
+ * @brief The names of the ValueTree properties that a type reads when it's 
+ *        created from a config, turned into Identifiers once.
+ *
+ * Building an Identifier from a string means a lookup in JUCE's global 
+ * string pool; looking a property up with an existing Identifier is just a 
+ * pointer comparison per property. Declare a type's schema as a static so 
+ * that the names are bound the first time an object of that type is 
+ * configured, and never again:
+ * ```
+ * void Configure(const ValueTree& config) override
+ * {
+ *    enum { kSize, kLabel };
+ *    static const ConfigSchema schema { "size", "label" };
+ *    Resize(schema.Get(config, kSize));
+ *    SetLabel(schema.Get(config, kLabel));
+ * }
+ * ```
+ */
+class ConfigSchema
+{
+public:
+   ConfigSchema(std::initializer_list<const char*> names)
+   {
+      fIds.ensureStorageAllocated(static_cast<int>(names.size()));
+      for (const char* name : names)
+      {
+         fIds.add(Identifier(name));
+      }
+   }
+
+   /**
+    * @return The value of one of the schema's properties in `config`, or a 
+    *         void var if the tree doesn't have it.
+    */
+   const var& Get(const ValueTree& config, int index) const noexcept
+   {
+      return config[fIds.getReference(index)];
+   }
+
+   /**
+    * @return The value of one of the schema's properties in `config`, or 
+    *         `defaultValue` if the tree doesn't have it.
+    */
+   var Get(const ValueTree& config, int index, const var& defaultValue) const
+   {
+      return config.getProperty(fIds.getReference(index), defaultValue);
+   }
+
+   const Identifier& operator[](int index) const noexcept
+   {
+      return fIds.getReference(index);
+   }
+
+   int size() const noexcept
+   {
+      return fIds.size();
+   }
+
+private:
+   Array<Identifier> fIds;
+
+   JUCE_DECLARE_NON_COPYABLE(ConfigSchema)
+};
+
+
+#endif  // CONFIGSCHEMA_H_INCLUDED
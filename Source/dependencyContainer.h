@@ -0,0 +1,529 @@
+/*
+ * Copyright (c) 2016 Brett g Porter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above
+ * copyright notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS",
+ * WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef DEPENDENCYCONTAINER_H_INCLUDED
+#define DEPENDENCYCONTAINER_H_INCLUDED
+
+#include "factory.h"
+#include "factoryDatabase.h"
+
+/**
+ * @class Dependencies
+ * @brief The objects that a DependencyContainer passes to the constructor 
+ *        of an object that it creates, in the order that they were listed 
+ *        when the object's type was registered.
+ */
+template <class T>
+class Dependencies
+{
+public:
+   Dependencies(T* const* objects, int count) noexcept
+   :  fObjects(objects)
+   ,  fCount(count)
+   {
+
+   }
+
+   int size() const noexcept
+   {
+      return fCount;
+   }
+
+   T* operator[](int index) const noexcept
+   {
+      jassert(index >= 0 && index < fCount);
+      return fObjects[index];
+   }
+
+   /**
+    * @return One of the dependencies, cast to the class that it's expected 
+    *         to be.
+    */
+   template <class U>
+   U* Get(int index) const
+   {
+      U* retval = dynamic_cast<U*>((*this)[index]);
+      // the type registered for this dependency isn't a U.
+      jassert(nullptr != retval);
+      return retval;
+   }
+
+private:
+   T* const* fObjects;
+   int fCount;
+};
+
+
+/**
+ * @class DependencyContainer
+ *
+ * @brief Wires together objects from a FactoryDatabase that depend on each 
+ *        other, using construction plans that are worked out once.
+ *
+ * Each type is registered with a lifetime and the names of the types that 
+ * its constructor needs:
+ * - kSingleton objects are created once by `Compile()` and shared by every 
+ *   scope. They can't depend on scoped objects, directly or through 
+ *   transient ones.
+ * - kScoped objects are created once per Scope.
+ * - kTransient objects are created for each object that depends on them.
+ *
+ * Types with dependencies are constructed from a `const Dependencies<T>&`, 
+ * so their factories are declared as e.g. 
+ * `Factory<Base, Handler, const Dependencies<Base>&>`. Types without any 
+ * can use any factory.
+ * ```
+ * DependencyContainer<Base> container;
+ * container.Register("logger", DependencyContainer<Base>::kSingleton);
+ * container.Register("session", DependencyContainer<Base>::kScoped, {"logger"});
+ * container.Register("handler", DependencyContainer<Base>::kScoped, 
+ *    {"session", "logger"});
+ * container.Compile();
+ *
+ * const DependencyContainer<Base>::Plan* handlerPlan = container.Resolve("handler");
+ * ...
+ * // per request:
+ * DependencyContainer<Base>::Scope scope(*handlerPlan);
+ * Base* handler = scope.GetRoot();
+ * ```
+ * `Compile()` looks up every factory and flattens each type's dependency 
+ * graph into a Plan: a list of steps in construction order, each of which 
+ * refers to its dependencies by their position in the list. Creating a 
+ * Scope is then one pass over the plan, with no names or hashing.
+ *
+ * Register all of the types before calling `Compile()`, and keep the 
+ * container alive for as long as any of its plans or scopes.
+ */
+template <class T>
+class DependencyContainer
+{
+public:
+   enum Lifetime
+   {
+      kSingleton,
+      kScoped,
+      kTransient
+   };
+
+   typedef FactoryWith<T, const Dependencies<T>&> Injector;
+
+   /**
+    * @class Plan
+    * @brief The steps needed to create one type and everything that it 
+    *        depends on.
+    */
+   class Plan
+   {
+   public:
+      /**
+       * @return The number of objects in a scope created from this plan 
+       *         (including singletons).
+       */
+      int GetNumSteps() const noexcept
+      {
+         return fSteps.size();
+      }
+
+   private:
+      friend class DependencyContainer;
+      friend class Scope;
+
+      struct Step
+      {
+         BaseFactory<T>* factory;
+         /// nullptr if the factory isn't created with dependencies.
+         Injector* injector;
+         /// the shared object, for singletons (which aren't created).
+         T* singleton;
+         /// where this step's dependencies are listed in fDependencies.
+         int firstDependency;
+         int numDependencies;
+      };
+
+      Array<Step> fSteps;
+      /// the steps that each step's dependencies come from.
+      Array<int> fDependencies;
+      int fMaxDependencies = 0;
+   };
+
+   /**
+    * @class Scope
+    * @brief The objects created by running a Plan. Singletons are shared, 
+    *        and everything else belongs to the scope and is destroyed with 
+    *        it, in the reverse of the order that it was created in.
+    */
+   class Scope
+   {
+   public:
+      explicit Scope(const Plan& plan)
+      :  fPlan(plan)
+      {
+         const int numSteps = plan.fSteps.size();
+         fObjects.ensureStorageAllocated(numSteps);
+         HeapBlock<T*> arguments(jmax(1, plan.fMaxDependencies));
+         for (int i = 0; i < numSteps; ++i)
+         {
+            const typename Plan::Step& step = plan.fSteps.getReference(i);
+            T* object = step.singleton;
+            if (nullptr == object)
+            {
+               for (int d = 0; d < step.numDependencies; ++d)
+               {
+                  arguments[d] = fObjects.getUnchecked(
+                     plan.fDependencies.getUnchecked(step.firstDependency + d));
+               }
+               if (nullptr != step.injector)
+               {
+                  object = step.injector->CreateWith(
+                     Dependencies<T>(arguments, step.numDependencies));
+               }
+               else
+               {
+                  object = step.factory->Create();
+               }
+            }
+            fObjects.add(object);
+         }
+      }
+
+      ~Scope()
+      {
+         for (int i = fObjects.size(); --i >= 0;)
+         {
+            const typename Plan::Step& step = fPlan.fSteps.getReference(i);
+            if (nullptr == step.singleton)
+            {
+               step.factory->GetDeleter()(fObjects.getUnchecked(i));
+            }
+         }
+      }
+
+      /**
+       * @return The object that the plan was made for.
+       */
+      T* GetRoot() const noexcept
+      {
+         return fObjects.getLast();
+      }
+
+      /**
+       * @return The object created by one of the plan's steps.
+       */
+      T* operator[](int index) const noexcept
+      {
+         return fObjects[index];
+      }
+
+      int size() const noexcept
+      {
+         return fObjects.size();
+      }
+
+   private:
+      const Plan& fPlan;
+      Array<T*> fObjects;
+
+      JUCE_DECLARE_NON_COPYABLE(Scope)
+   };
+
+   DependencyContainer()
+   :  fCompiled(false)
+   {
+
+   }
+
+   /**
+    * Add a type to the container.
+    * @param  name         Name that the type's factory is registered under.
+    * @param  lifetime     How long its objects live.
+    * @param  dependencies Names of the types passed to its constructor, in 
+    *                      order.
+    * @return false if the name is already registered, or the container has 
+    *         been compiled.
+    */
+   bool Register(StringRef name, Lifetime lifetime, 
+      const StringArray& dependencies = StringArray())
+   {
+      // register everything before compiling.
+      jassert(! fCompiled);
+      const String key(name);
+      if (fCompiled || fIndex.contains(key))
+      {
+         return false;
+      }
+      Registration* registration = new Registration();
+      registration->name = key;
+      registration->lifetime = lifetime;
+      registration->dependencyNames = dependencies;
+      fIndex.set(key, fRegistrations.size());
+      fRegistrations.add(registration);
+      return true;
+   }
+
+   /**
+    * Look up every registered type's factory, create the singletons, and 
+    * build a plan for each type. Compiling again does nothing (the plans 
+    * and singletons that are already in use stay as they are).
+    * @return false (with nothing compiled) if a name or dependency is 
+    *         unknown, a type with dependencies isn't constructed from 
+    *         Dependencies, a type without any needs other constructor 
+    *         arguments, the dependencies form a cycle, or a singleton 
+    *         depends on a scoped type (directly or through transients).
+    */
+   bool Compile()
+   {
+      if (fCompiled)
+      {
+         return true;
+      }
+      bool ok = true;
+      for (int i = 0; ok && i < fRegistrations.size(); ++i)
+      {
+         ok = Bind(*fRegistrations.getUnchecked(i));
+      }
+      for (int i = 0; ok && i < fRegistrations.size(); ++i)
+      {
+         // singletons can't hang on to objects that die with a scope.
+         const Registration& registration = *fRegistrations.getUnchecked(i);
+         if (kSingleton == registration.lifetime)
+         {
+            Array<bool> visited;
+            visited.insertMultiple(0, false, fRegistrations.size());
+            ok = ! NeedsScoped(registration, visited);
+         }
+      }
+      for (int i = 0; ok && i < fRegistrations.size(); ++i)
+      {
+         ok = (nullptr != GetPlan(i));
+      }
+      if (! ok)
+      {
+         fSingletons.clear();
+         for (Registration* registration : fRegistrations)
+         {
+            registration->plan = nullptr;
+            registration->creationPlan = nullptr;
+            registration->singleton = nullptr;
+         }
+      }
+      fCompiled = ok;
+      return ok;
+   }
+
+   /**
+    * @return The plan for creating a registered type, or nullptr if the name
+    *         is unknown or the container hasn't been compiled. Look plans up 
+    *         once and keep them; this is the only part that uses the name.
+    */
+   const Plan* Resolve(StringRef name) const
+   {
+      const Plan* retval = nullptr;
+      const String key(name);
+      if (fCompiled && fIndex.contains(key))
+      {
+         retval = fRegistrations.getUnchecked(fIndex[key])->plan;
+      }
+      return retval;
+   }
+
+   bool IsCompiled() const noexcept
+   {
+      return fCompiled;
+   }
+
+private:
+   struct Registration
+   {
+      String name;
+      Lifetime lifetime;
+      StringArray dependencyNames;
+      Array<int> dependencies;
+      BaseFactory<T>* factory = nullptr;
+      Injector* injector = nullptr;
+      ScopedPointer<Plan> plan;
+      /// for singletons, the plan that the container used to create it.
+      ScopedPointer<Plan> creationPlan;
+      T* singleton = nullptr;
+      /// set while the plan is being built, to find cycles.
+      bool building = false;
+   };
+
+   /**
+    * Find a registration's factory and the registrations it depends on.
+    */
+   bool Bind(Registration& registration)
+   {
+      registration.factory = T::Resolve(registration.name).GetFactory();
+      registration.injector = dynamic_cast<Injector*>(registration.factory);
+      registration.dependencies.clearQuick();
+      bool ok = (nullptr != registration.factory);
+      // types with dependencies have to be constructed from them, and the 
+      // rest have to be constructible from nothing.
+      ok = ok && (nullptr != registration.injector || (registration.dependencyNames.isEmpty() 
+         && registration.factory->CanCreate()));
+      for (int i = 0; ok && i < registration.dependencyNames.size(); ++i)
+      {
+         const String& dependency = registration.dependencyNames[i];
+         ok = fIndex.contains(dependency);
+         if (ok)
+         {
+            registration.dependencies.add(fIndex[dependency]);
+         }
+      }
+      return ok;
+   }
+
+   /**
+    * @return true if a registration depends on a scoped type, either 
+    *         directly or through transient types (which are created along
+    *         with it). Other singletons are checked on their own.
+    * @param  visited The transient registrations that have been looked at 
+    *                 already, by index.
+    */
+   bool NeedsScoped(const Registration& registration, Array<bool>& visited) const
+   {
+      for (int dependency : registration.dependencies)
+      {
+         const Registration& needed = *fRegistrations.getUnchecked(dependency);
+         if (kScoped == needed.lifetime)
+         {
+            return true;
+         }
+         if (kTransient == needed.lifetime && ! visited[dependency])
+         {
+            visited.set(dependency, true);
+            if (NeedsScoped(needed, visited))
+            {
+               return true;
+            }
+         }
+      }
+      return false;
+   }
+
+   /**
+    * @return The plan for a registration, building it (and creating the 
+    *         registration's singleton) if it hasn't been yet. nullptr if 
+    *         the registration's dependencies form a cycle.
+    */
+   Plan* GetPlan(int index)
+   {
+      Registration& registration = *fRegistrations.getUnchecked(index);
+      if (nullptr == registration.plan)
+      {
+         ScopedPointer<Plan> plan(new Plan());
+         HashMap<int, int> shared;
+         if (AddSteps(index, index, *plan, shared) >= 0)
+         {
+            if (kSingleton == registration.lifetime)
+            {
+               // the container keeps the singleton and the plan that 
+               // created it; everyone else's plan just hands it out.
+               registration.creationPlan = plan.release();
+               Scope* scope = new Scope(*registration.creationPlan);
+               fSingletons.add(scope);
+               registration.singleton = scope->GetRoot();
+               plan = new Plan();
+               shared.clear();
+               AddSteps(index, -1, *plan, shared);
+            }
+            registration.plan = plan.release();
+         }
+      }
+      return registration.plan;
+   }
+
+   /**
+    * Add the steps that create a registration's object, after the steps for 
+    * its dependencies. 
+    * @param  root   The registration that the plan is being built for, 
+    *                which is created by the plan even if it's a singleton.
+    * @param  shared Steps already in the plan for objects that the plan 
+    *                only creates once, by registration index.
+    * @return The step that creates the object, or -1 if there's a cycle.
+    */
+   int AddSteps(int index, int root, Plan& plan, HashMap<int, int>& shared)
+   {
+      Registration& registration = *fRegistrations.getUnchecked(index);
+      if (shared.contains(index))
+      {
+         return shared[index];
+      }
+      // a cycle.
+      if (registration.building)
+      {
+         return -1;
+      }
+
+      typename Plan::Step step = { registration.factory, registration.injector, 
+         nullptr, 0, 0 };
+      if (kSingleton == registration.lifetime && index != root)
+      {
+         if (nullptr == registration.singleton && nullptr == GetPlan(index))
+         {
+            return -1;
+         }
+         step.singleton = registration.singleton;
+      }
+      else
+      {
+         registration.building = true;
+         Array<int> dependencySteps;
+         for (int dependency : registration.dependencies)
+         {
+            const int dependencyStep = AddSteps(dependency, root, plan, shared);
+            if (dependencyStep < 0)
+            {
+               registration.building = false;
+               return -1;
+            }
+            dependencySteps.add(dependencyStep);
+         }
+         registration.building = false;
+         step.firstDependency = plan.fDependencies.size();
+         step.numDependencies = dependencySteps.size();
+         plan.fDependencies.addArray(dependencySteps);
+         plan.fMaxDependencies = jmax(plan.fMaxDependencies, step.numDependencies);
+      }
+
+      const int retval = plan.fSteps.size();
+      plan.fSteps.add(step);
+      if (kTransient != registration.lifetime)
+      {
+         shared.set(index, retval);
+      }
+      return retval;
+   }
+
+   OwnedArray<Registration> fRegistrations;
+   HashMap<String, int> fIndex;
+   /// one scope per singleton, in the order they were created (OwnedArray 
+   /// deletes them backwards, so dependents go first).
+   OwnedArray<Scope> fSingletons;
+   bool fCompiled;
+
+   JUCE_DECLARE_NON_COPYABLE(DependencyContainer)
+};
+
+
+#endif  // DEPENDENCYCONTAINER_H_INCLUDED
@@ -22,20 +22,16 @@
  */
 
 #include "derived.h"
-#include "factory.h"
-
-namespace
-{
-   // here in an anonymous namespace, we create an instance of the 
-   // appropriate Factory type for each of the derived classes we wish to 
-   // be able to create through the `Base::Create("someType")` interface. 
-   // Creating these has as a side effect the registration of the factory 
-   // classes in the factory database object, so there's nothing else to do
-   // for these factories to be usable. 
-   Factory<Base, Unity>    unityFactory("unity");
-   Factory<Base, Smaller>  smallerFactory("smaller");
-   Factory<Base, Bigger>   biggerFactory("bigger");
-};
+#include "factoryRecord.h"
+
+// Register each of the derived classes that we wish to be able to create 
+// through the `Base::Create("someType")` interface. These are records in 
+// the `cf_base` linker section rather than Factory objects, so nothing runs
+// here during static initialization; each factory is created the first time
+// its type is looked up.
+FACTORY_RECORD(cf_base, Base, Unity, BaseTypes::kUnity);
+FACTORY_RECORD(cf_base, Base, Smaller, BaseTypes::kSmaller);
+FACTORY_RECORD(cf_base, Base, Bigger, BaseTypes::kBigger);
 
 
 
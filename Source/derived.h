@@ -27,6 +27,25 @@
 #include "base.h"
 
 
+/**
+ * The names that the classes below are registered with. Using these rather 
+ * than string literals means the names are hashed at compile time, and lets us
+ * check for hash collisions at compile time too -- but only between the 
+ * names listed in `kAll`. A name added anywhere else isn't covered by the 
+ * `static_assert`; recorded names are only checked in Debug builds, when the
+ * record index is built (see FactoryDatabase::GetRecordIndex()).
+ */
+namespace BaseTypes
+{
+   constexpr TypeName kUnity("unity");
+   constexpr TypeName kSmaller("smaller");
+   constexpr TypeName kBigger("bigger");
+
+   constexpr TypeName kAll[] = { kUnity, kSmaller, kBigger };
+   static_assert(TypeName::AreDistinct(kAll), "Base type names must have distinct hashes");
+}
+
+
 /**
  * @class Unity
  *
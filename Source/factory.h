@@ -26,6 +26,193 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 
+#include "objectArena.h"
+#include "typeName.h"
+
+#include <atomic>
+#include <memory>
+
+template <class T> class BaseFactory;
+
+
+/**
+ * @class FactoryDeleter
+ * @brief Deleter for the `std::unique_ptr`s returned by `CreateUnique()`.
+ *
+ * Each factory gives out a deleter that knows how the factory allocated its
+ * objects, so whatever allocation strategy a type uses, its objects are 
+ * always released the right way without the code holding the pointer 
+ * needing to know about it. A default-constructed deleter just uses 
+ * `delete`.
+ */
+template <class T>
+class FactoryDeleter
+{
+public:
+   typedef void (*DestroyFunction)(T*);
+
+   FactoryDeleter() noexcept
+   :  fDestroy(nullptr)
+   {
+
+   }
+
+   explicit FactoryDeleter(DestroyFunction destroy) noexcept
+   :  fDestroy(destroy)
+   {
+
+   }
+
+   void operator()(T* object) const noexcept
+   {
+      if (nullptr != fDestroy)
+      {
+         fDestroy(object);
+      }
+      else
+      {
+         delete object;
+      }
+   }
+
+private:
+   DestroyFunction fDestroy;
+};
+
+
+/**
+ * The smart pointer type returned by `CreateUnique()`.
+ */
+template <class T>
+using FactoryPtr = std::unique_ptr<T, FactoryDeleter<T> >;
+
+
+/**
+ * @struct FactoryLayout
+ * @brief How much memory a registered type needs, and how it must be 
+ *        aligned, for creating objects in storage that you provide.
+ */
+struct FactoryLayout
+{
+   /// `sizeof` the class, or 0 if unknown.
+   size_t size;
+   /// `alignof` the class, or 0 if unknown.
+   size_t alignment;
+};
+
+
+/**
+ * @struct RecycleStats
+ * @brief How well a factory's cache of recycled objects is doing.
+ */
+struct RecycleStats
+{
+   /// objects handed out from the cache of recycled objects.
+   int64 hits;
+   /// objects handed out that were created ahead of time by `Prewarm()` (or
+   /// `Park()`), which aren't counted as hits.
+   int64 prewarmed;
+   /// objects that had to be constructed because the cache was empty.
+   int64 misses;
+   /// objects that were released into the cache.
+   int64 recycled;
+   /// objects that were destroyed on release because the cache was full.
+   int64 discarded;
+   /// the most objects that the cache will hold, or 0 if recycling is off.
+   int maxCached;
+};
+
+
+/**
+ * @class FactoryDescriptor
+ * @brief Everything we know about one registered type, owned by its factory.
+ *
+ * Every object that a factory creates points back at its descriptor instead 
+ * of carrying its own copy of the type name, so objects only pay for one 
+ * pointer, and getting an object's type name doesn't copy anything.
+ */
+template <class T>
+class FactoryDescriptor
+{
+public:
+   FactoryDescriptor(StringRef typeName, size_t size, size_t alignment, 
+      BaseFactory<T>* factory)
+   :  fTypeName(typeName)
+   ,  fHash(TypeNameHash::Calculate(typeName))
+   ,  fSize(size)
+   ,  fAlignment(alignment)
+   ,  fFactory(factory)
+   {
+
+   }
+
+   /**
+    * @return The name that the type is registered under.
+    */
+   const String& GetTypeName() const noexcept
+   {
+      return fTypeName;
+   }
+
+   /**
+    * @return The hash of the type name (see TypeNameHash).
+    */
+   uint64 GetHash() const noexcept
+   {
+      return fHash;
+   }
+
+   /**
+    * @return `sizeof` the C++ class that gets created, or 0 if unknown.
+    */
+   size_t GetSize() const noexcept
+   {
+      return fSize;
+   }
+
+   /**
+    * @return `alignof` the C++ class that gets created, or 0 if unknown.
+    */
+   size_t GetAlignment() const noexcept
+   {
+      return fAlignment;
+   }
+
+   /**
+    * @return The size and alignment together.
+    */
+   FactoryLayout GetLayout() const noexcept
+   {
+      FactoryLayout layout = { fSize, fAlignment };
+      return layout;
+   }
+
+   /**
+    * @return The factory that creates objects of this type.
+    */
+   BaseFactory<T>* GetFactory() const noexcept
+   {
+      return fFactory;
+   }
+
+private:
+   const String fTypeName;
+   const uint64 fHash;
+   const size_t fSize;
+   const size_t fAlignment;
+   BaseFactory<T>* const fFactory;
+
+   JUCE_DECLARE_NON_COPYABLE(FactoryDescriptor)
+};
+
+
+/**
+ * Passed to a factory's constructor to stop it registering itself with its 
+ * class hierarchy's database, for factories that are found some other way 
+ * (see FactoryRecord).
+ */
+struct UnregisteredFactory {};
+
 
 /**
  * @class BaseFactory
@@ -39,54 +226,545 @@ class BaseFactory
 {
 public:
    /**
-    * @param name The name of the 'type' of object that this factory can create.
+    * @param name      The name of the 'type' of object that this factory can create.
+    * @param size      `sizeof` the class that it creates, if known.
+    * @param alignment `alignof` the class that it creates, if known.
+    * @param deleter   Deleter that knows how to release the objects that 
+    *                  `Create()` returns.
     */   
-   BaseFactory(StringRef typeName)
-   :  fTypeName(typeName)
+   BaseFactory(StringRef typeName, size_t size = 0, size_t alignment = 0,
+      FactoryDeleter<T> deleter = FactoryDeleter<T>())
+   :  BaseFactory(typeName, size, alignment, deleter, UnregisteredFactory())
    {
       T::RegisterFactory(typeName, this );
    }
+
+   /**
+    * A factory that doesn't register itself, so it can only be used 
+    * directly (or through whatever finds it, like a FactoryRecord).
+    */
+   BaseFactory(StringRef typeName, size_t size, size_t alignment,
+      FactoryDeleter<T> deleter, UnregisteredFactory)
+   :  fDescriptor(typeName, size, alignment, this)
+   ,  fDeleter(deleter)
+   ,  fNumParked(0)
+   ,  fMaxRecycled(0)
+   ,  fRecycleMisses(0)
+   {
+      zerostruct(fRecycleStats);
+   }
    
-   virtual ~BaseFactory() = default;
+   virtual ~BaseFactory()
+   {
+      DiscardParked();
+   }
    
+   /**
+    * Create an object. Returns nullptr if the class can only be constructed 
+    * with arguments (see `CanCreate()`), and so do `Create(ObjectArena&)` and 
+    * `CreateAt()`.
+    */
    virtual T* Create() = 0;
+
+   /**
+    * Create an object inside an arena, which owns it from then on. 
+    */
+   virtual T* Create(ObjectArena& arena) = 0;
+
+   /**
+    * Construct an object in storage provided by the caller, which must be at 
+    * least as big and as strictly aligned as `GetDescriptor().GetLayout()` 
+    * says. The caller is responsible for calling the object's destructor 
+    * (but not `delete`) when done with it.
+    */
+   virtual T* CreateAt(void* buffer) = 0;
+
+   /**
+    * Create a copy of an object that was created by this factory. 
+    * @return The copy, or nullptr if the class can't be copied.
+    */
+   virtual T* Clone(const T& original) = 0;
+
+   /**
+    * Move an object that this factory created into storage provided by the 
+    * caller (as for `CreateAt()`). The original is left moved-from, and the
+    * caller still has to destroy it.
+    * @return The object in its new home, or nullptr if the class can't be 
+    *         moved or copied.
+    */
+   virtual T* MoveAt(T& original, void* buffer) = 0;
+
+   /**
+    * @return true if `MoveAt()` works for this factory's class.
+    */
+   virtual bool CanMove() const = 0;
+
+   /**
+    * @return true if `Create()`, `Create(ObjectArena&)` and `CreateAt()` work
+    *         for this factory's class, which they don't if it can only be 
+    *         constructed with arguments (use `CreateWith()` for those).
+    */
+   virtual bool CanCreate() const = 0;
+
+   /**
+    * Create an object owned by a `std::unique_ptr` whose deleter knows how 
+    * this factory allocated it.
+    */
+   FactoryPtr<T> CreateUnique()
+   {
+      if (IsRecycling())
+      {
+         return FactoryPtr<T>(TakeOrCreate(), FactoryDeleter<T>(&ReleaseToFactory));
+      }
+      return FactoryPtr<T>(TakeOrCreate(), fDeleter);
+   }
+
+   /**
+    * Hand out one of the objects that were recycled with `Release()` or 
+    * created ahead of time with `Park()`, or create a new one if there 
+    * aren't any left. Recycled objects go first, since they're the most 
+    * likely to still be in the cache.
+    */
+   T* TakeOrCreate()
+   {
+      // don't touch the lock unless there's something to take.
+      if (fNumParked.load(std::memory_order_relaxed) > 0)
+      {
+         const SpinLock::ScopedLockType sl(fParkedLock);
+         if (fRecycled.size() > 0)
+         {
+            fNumParked.store(fRecycled.size() + fParked.size() - 1, std::memory_order_relaxed);
+            ++fRecycleStats.hits;
+            return fRecycled.removeAndReturn(fRecycled.size() - 1);
+         }
+         if (fParked.size() > 0)
+         {
+            fNumParked.store(fParked.size() - 1, std::memory_order_relaxed);
+            ++fRecycleStats.prewarmed;
+            return fParked.removeAndReturn(fParked.size() - 1);
+         }
+      }
+      if (IsRecycling())
+      {
+         fRecycleMisses.fetch_add(1, std::memory_order_relaxed);
+      }
+      return Create();
+   }
+
+   /**
+    * Turn recycling on or off. While it's on, objects that are given back 
+    * with `Release()` (which is what the deleter of a `CreateUnique()` 
+    * pointer does) have their `Reset()` method called and are kept, up to
+    * `maxCached` of them, to be handed out again without being constructed.
+    * @param maxCached The most objects to keep, or 0 to turn recycling off.
+    */
+   void SetRecycling(int maxCached)
+   {
+      jassert(maxCached >= 0);
+      fMaxRecycled.store(maxCached);
+   }
+
+   bool IsRecycling() const noexcept
+   {
+      return (fMaxRecycled.load(std::memory_order_relaxed) > 0);
+   }
+
+   /**
+    * Give back an object that this factory created. If recycling is on and 
+    * there's room, the object is reset and cached, otherwise it's destroyed.
+    */
+   void Release(T* object)
+   {
+      if (nullptr == object)
+      {
+         return;
+      }
+      jassert(&fDescriptor == object->GetDescriptor());
+      const int maxCached = fMaxRecycled.load(std::memory_order_relaxed);
+      if (maxCached > 0)
+      {
+         // don't run the object's code with the lock held.
+         object->Reset();
+         const SpinLock::ScopedLockType sl(fParkedLock);
+         if (fRecycled.size() < maxCached)
+         {
+            fRecycled.add(object);
+            fNumParked.store(fRecycled.size() + fParked.size(), std::memory_order_relaxed);
+            ++fRecycleStats.recycled;
+            return;
+         }
+         ++fRecycleStats.discarded;
+      }
+      fDeleter(object);
+   }
+
+   /**
+    * @return The recycling statistics for this factory.
+    */
+   RecycleStats GetRecycleStats() const noexcept
+   {
+      const SpinLock::ScopedLockType sl(fParkedLock);
+      RecycleStats retval = fRecycleStats;
+      retval.misses = fRecycleMisses.load(std::memory_order_relaxed);
+      retval.maxCached = fMaxRecycled.load(std::memory_order_relaxed);
+      return retval;
+   }
+
+   /**
+    * Keep an object that this factory created, unused, to be handed out by
+    * the next call to `TakeOrCreate()`. Safe to call from any thread.
+    */
+   void Park(T* object)
+   {
+      jassert(nullptr == object || &fDescriptor == object->GetDescriptor());
+      if (nullptr != object)
+      {
+         const SpinLock::ScopedLockType sl(fParkedLock);
+         fParked.add(object);
+         fNumParked.store(fRecycled.size() + fParked.size(), std::memory_order_relaxed);
+      }
+   }
+
+   /**
+    * @return The number of objects waiting to be handed out, recycled or 
+    *         created ahead of time.
+    */
+   int GetNumParked() const noexcept
+   {
+      return fNumParked.load(std::memory_order_relaxed);
+   }
+
+   /**
+    * Delete all of the objects that are waiting to be handed out.
+    */
+   void DiscardParked()
+   {
+      Array<T*> parked;
+      {
+         const SpinLock::ScopedLockType sl(fParkedLock);
+         parked.swapWith(fParked);
+         parked.addArray(fRecycled);
+         fRecycled.clearQuick();
+         fNumParked.store(0, std::memory_order_relaxed);
+      }
+      for (T* object : parked)
+      {
+         fDeleter(object);
+      }
+   }
+
+   /**
+    * @return The deleter for objects returned by `Create()`.
+    */
+   const FactoryDeleter<T>& GetDeleter() const noexcept
+   {
+      return fDeleter;
+   }
+
+   /**
+    * @return The name that this factory is registered under.
+    */
+   const String& GetTypeName() const noexcept
+   {
+      return fDescriptor.GetTypeName();
+   }
+
+   /**
+    * @return The descriptor shared by every object that this factory creates.
+    */
+   const FactoryDescriptor<T>& GetDescriptor() const noexcept
+   {
+      return fDescriptor;
+   }
    
 protected:
-   /// the 'type name' for classes created by this factory, which may or
+   /// the 'type name' for classes created by this factory (which may or
    /// may not be the same as the C++ name of the classes created by this
-   /// factory.
-   String fTypeName;  
+   /// factory), along with the rest of what we know about them.
+   FactoryDescriptor<T> fDescriptor;  
+
+   FactoryDeleter<T> fDeleter;
+
+private:
+   static void ReleaseToFactory(T* object)
+   {
+      object->GetDescriptor()->GetFactory()->Release(object);
+   }
+
+   /// objects created ahead of time by `Prewarm()`.
+   Array<T*> fParked;
+   /// objects given back with `Release()`, kept for reuse.
+   Array<T*> fRecycled;
+   /// fParked.size() + fRecycled.size(), readable without the lock.
+   std::atomic<int> fNumParked;
+   std::atomic<int> fMaxRecycled;
+   std::atomic<int64> fRecycleMisses;
+   /// protected by fParkedLock, apart from `misses`.
+   RecycleStats fRecycleStats;
+   SpinLock fParkedLock;
    
    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BaseFactory); 
 };
 
 
+/**
+ * @class FactoryWith
+ * @brief Interface of factories whose classes are constructed with 
+ *        arguments, so that objects can be built with their final state 
+ *        instead of being default-constructed and then set up.
+ *
+ * `Args` are the parameter types of the constructor, exactly as they're 
+ * spelled in the Factory that implements this (e.g. `int, const String&`); 
+ * FactoryDatabase::CreateWith() finds the factory using those types.
+ */
+template <class T, class... Args>
+class FactoryWith
+{
+public:
+   virtual ~FactoryWith() {}
+
+   /**
+    * Create an object, passing `args` to its constructor.
+    */
+   virtual T* CreateWith(Args... args) = 0;
+};
+
 
-template <class T, class Derived>
-class Factory : public BaseFactory<T>
+/**
+ * @class Factory
+ * @brief Creates objects of class `Derived`.
+ *
+ * Any `Args` are the types of a constructor of `Derived` that 
+ * `CreateWith()` passes its arguments on to:
+ * ```
+ * static Factory<Base, Sized, int> sizedFactory("sized");
+ * ...
+ * Base* s = Base::CreateWith<int>("sized", 64);    // new Sized(64)
+ * ```
+ * A class that can't be default-constructed can only be created with 
+ * `CreateWith()` (or cloned); `Create()` and friends return nullptr for it,
+ * and `CanCreate()` is false.
+ *
+ * Note that `CreateWith()` on the database finds the factory for `Args` at
+ * run time: the only compile-time check is that `Derived` can be 
+ * constructed from the `Args` its own factory declares.
+ */
+template <class T, class Derived, class... Args>
+class Factory : public BaseFactory<T>, public FactoryWith<T, Args...>
 {
+   // make sure that there's a valid base/derived relationship between the
+   // two classes that this factory is templated on.
+   static_assert(std::is_base_of<T, Derived>::value, "");
+   static_assert(std::is_constructible<Derived, Args...>::value, 
+      "Derived can't be constructed from Args");
+
 public:
    Factory(StringRef typeName)
-   :  BaseFactory<T>(typeName)
+   :  Factory(typeName, FactoryDeleter<T>(&Destroy))
    {
-      // compile time assertion to make sure that there's a valid 
-      // base/derived relationship between the two classes that this 
-      // factory is templated on.
-      static_assert(std::is_base_of<T, Derived>::value, "");
+
+   }
+
+   Factory(StringRef typeName, UnregisteredFactory unregistered)
+   :  Factory(typeName, FactoryDeleter<T>(&Destroy), unregistered)
+   {
+
    }
    
    ~Factory() = default;
    
    T* Create() override
    {
-      T* retval = new Derived();
-      if (retval)
+      return Construct(nullptr, nullptr, std::is_default_constructible<Derived>());
+   }
+
+   T* Create(ObjectArena& arena) override
+   {
+      return Construct(nullptr, &arena, std::is_default_constructible<Derived>());
+   }
+
+   T* CreateAt(void* buffer) override
+   {
+      return Construct(buffer, nullptr, std::is_default_constructible<Derived>());
+   }
+
+   T* CreateWith(Args... args) override
+   {
+      T* retval = new Derived(std::forward<Args>(args)...);
+      retval->SetDescriptor(&(BaseFactory<T>::fDescriptor));
+      return retval;
+   }
+
+   T* Clone(const T& original) override
+   {
+      return Copy(original, std::is_copy_constructible<Derived>());
+   }
+
+   T* MoveAt(T& original, void* buffer) override
+   {
+      return Move(original, buffer, std::is_move_constructible<Derived>());
+   }
+
+   bool CanMove() const override
+   {
+      return std::is_move_constructible<Derived>::value;
+   }
+
+   bool CanCreate() const override
+   {
+      return std::is_default_constructible<Derived>::value;
+   }
+
+protected:
+   /**
+    * For subclasses that allocate objects differently. 
+    */
+   Factory(StringRef typeName, FactoryDeleter<T> deleter)
+   :  BaseFactory<T>(typeName, sizeof(Derived), alignof(Derived), deleter)
+   {
+
+   }
+
+   Factory(StringRef typeName, FactoryDeleter<T> deleter, UnregisteredFactory unregistered)
+   :  BaseFactory<T>(typeName, sizeof(Derived), alignof(Derived), deleter, unregistered)
+   {
+
+   }
+
+private:
+   /**
+    * Default-construct an object, in `buffer` or `arena` if they're given, 
+    * otherwise on the heap.
+    */
+   T* Construct(void* buffer, ObjectArena* arena, std::true_type)
+   {
+      T* retval = nullptr;
+      if (nullptr != arena)
+      {
+         retval = arena->Construct<Derived>();
+      }
+      else if (nullptr != buffer)
+      {
+         retval = new (buffer) Derived();
+      }
+      else
       {
-         retval->SetTypeName(BaseFactory<T>::fTypeName);
+         retval = new Derived();
       }
+      retval->SetDescriptor(&(BaseFactory<T>::fDescriptor));
       return retval;
    }
+
+   T* Construct(void*, ObjectArena*, std::false_type)
+   {
+      // Derived needs constructor arguments -- use CreateWith(). Not an 
+      // assertion, since names often come from data (see CanCreate()).
+      return nullptr;
+   }
+
+   T* Copy(const T& original, std::true_type)
+   {
+      T* retval = new Derived(static_cast<const Derived&>(original));
+      retval->SetDescriptor(&(BaseFactory<T>::fDescriptor));
+      return retval;
+   }
+
+   T* Copy(const T&, std::false_type)
+   {
+      // Derived doesn't have a copy constructor.
+      jassertfalse;
+      return nullptr;
+   }
+
+   T* Move(T& original, void* buffer, std::true_type)
+   {
+      T* retval = new (buffer) Derived(std::move(static_cast<Derived&>(original)));
+      retval->SetDescriptor(&(BaseFactory<T>::fDescriptor));
+      return retval;
+   }
+
+   T* Move(T&, void*, std::false_type)
+   {
+      // Derived can't be moved or copied.
+      jassertfalse;
+      return nullptr;
+   }
+
+   static void Destroy(T* object)
+   {
+      delete static_cast<Derived*>(object);
+   }
+};
+
+
+/**
+ * @class PrototypeFactory
+ * @brief A factory that creates its objects by copying a prototype instead of
+ *        default-constructing them.
+ *
+ * Use this for types that are expensive to set up but cheap to copy: 
+ * configure one object, and register it under its own name.
+ * ```
+ * Scaled tripled;
+ * tripled.SetFactor(3);
+ * PrototypeFactory<Base, Scaled> triplerFactory("tripler", tripled);
+ * ...
+ * ScopedPointer<Base> t = Base::Create("tripler");   // a copy of `tripled`
+ * ```
+ * The factory keeps its own copy of the prototype. Objects in an arena, or 
+ * created with `CreateAt()`, are copies too.
+ */
+template <class T, class Derived>
+class PrototypeFactory : public Factory<T, Derived>
+{
+public:
+   PrototypeFactory(StringRef typeName, const Derived& prototype)
+   :  Factory<T, Derived>(typeName)
+   ,  fPrototype(prototype)
+   {
+      static_assert(std::is_copy_constructible<Derived>::value, 
+         "prototypes have to be copyable");
+   }
+
+   T* Create() override
+   {
+      return Factory<T, Derived>::Clone(fPrototype);
+   }
+
+   T* CreateWith() override
+   {
+      return Create();
+   }
+
+   bool CanCreate() const override
+   {
+      return true;
+   }
+
+   T* Create(ObjectArena& arena) override
+   {
+      T* retval = arena.Construct<Derived>(fPrototype);
+      retval->SetDescriptor(&(BaseFactory<T>::fDescriptor));
+      return retval;
+   }
+
+   T* CreateAt(void* buffer) override
+   {
+      T* retval = new (buffer) Derived(fPrototype);
+      retval->SetDescriptor(&(BaseFactory<T>::fDescriptor));
+      return retval;
+   }
+
+   /**
+    * @return The object that this factory makes copies of.
+    */
+   const Derived& GetPrototype() const noexcept
+   {
+      return fPrototype;
+   }
+
 private:
+   const Derived fPrototype;
 };
 
 
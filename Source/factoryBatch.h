@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2016 Brett g Porter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above
+ * copyright notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS",
+ * WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FACTORYBATCH_H_INCLUDED
+#define FACTORYBATCH_H_INCLUDED
+
+#include "factory.h"
+
+/**
+ * @class FactoryBatch
+ *
+ * @brief A block of objects of one type, all created at once by one factory
+ *        in a single allocation, laid out one after another.
+ *
+ * Returned by `CreateBatch()`:
+ * ```
+ * FactoryBatch<Base> batch = Base::CreateBatch("smaller", 10000);
+ * for (Base* b : batch)
+ * {
+ *    b->SomeIntOperation(1);
+ * }
+ * ```
+ * The batch owns its objects and destroys them (last first) when it's 
+ * destroyed. Batches can be moved but not copied.
+ */
+template <class T>
+class FactoryBatch
+{
+public:
+   /**
+    * @class Iterator
+    * @brief Steps through the objects in a batch, giving a `T*` for each.
+    */
+   class Iterator
+   {
+   public:
+      Iterator(const FactoryBatch& batch, int index) noexcept
+      :  fBatch(batch)
+      ,  fIndex(index)
+      {
+
+      }
+
+      T* operator*() const noexcept
+      {
+         return fBatch[fIndex];
+      }
+
+      Iterator& operator++() noexcept
+      {
+         ++fIndex;
+         return *this;
+      }
+
+      bool operator!=(const Iterator& other) const noexcept
+      {
+         return fIndex != other.fIndex;
+      }
+
+   private:
+      const FactoryBatch& fBatch;
+      int fIndex;
+   };
+
+   /**
+    * Create an empty batch.
+    */
+   FactoryBatch() noexcept
+   :  fObjects(nullptr)
+   ,  fStride(0)
+   ,  fOffset(0)
+   ,  fNumObjects(0)
+   {
+
+   }
+
+   /**
+    * Create `count` objects using `factory`. If the factory can't create 
+    * objects without constructor arguments, the batch is empty.
+    */
+   FactoryBatch(BaseFactory<T>& factory, int count)
+   :  FactoryBatch()
+   {
+      const FactoryLayout layout = factory.GetDescriptor().GetLayout();
+      jassert(layout.size > 0 && layout.alignment > 0);
+      fStride = (layout.size + layout.alignment - 1) & ~(layout.alignment - 1);
+
+      fStorage.malloc(fStride * count + layout.alignment);
+      fObjects = reinterpret_cast<char*>((reinterpret_cast<pointer_sized_uint>(fStorage.getData()) 
+         + layout.alignment - 1) & ~static_cast<pointer_sized_uint>(layout.alignment - 1));
+
+      for (int i = 0; i < count; ++i)
+      {
+         char* slot = fObjects + i * fStride;
+         T* object = factory.CreateAt(slot);
+         if (nullptr == object)
+         {
+            // nothing was constructed in this slot (see 
+            // BaseFactory::CanCreate()), so it mustn't be destroyed either.
+            break;
+         }
+         // every object is a Derived, so T is always at the same offset.
+         fOffset = reinterpret_cast<char*>(object) - slot;
+         // we've delegated to the default ctor, so if a constructor throws
+         // our destructor runs and cleans up the objects counted so far.
+         ++fNumObjects;
+      }
+   }
+
+   FactoryBatch(FactoryBatch&& other) noexcept
+   :  FactoryBatch()
+   {
+      Swap(other);
+   }
+
+   FactoryBatch& operator=(FactoryBatch&& other) noexcept
+   {
+      FactoryBatch(static_cast<FactoryBatch&&>(other)).Swap(*this);
+      return *this;
+   }
+
+   ~FactoryBatch()
+   {
+      while (fNumObjects > 0)
+      {
+         ObjectAt(--fNumObjects)->~T();
+      }
+   }
+
+   /**
+    * @return The number of objects in the batch.
+    */
+   int size() const noexcept
+   {
+      return fNumObjects;
+   }
+
+   bool IsEmpty() const noexcept
+   {
+      return (0 == fNumObjects);
+   }
+
+   /**
+    * @return The object at `index`, which must be in range.
+    */
+   T* operator[](int index) const noexcept
+   {
+      jassert(isPositiveAndBelow(index, fNumObjects));
+      return ObjectAt(index);
+   }
+
+   /**
+    * @return The distance in bytes from one object to the next.
+    */
+   size_t GetStride() const noexcept
+   {
+      return fStride;
+   }
+
+   Iterator begin() const noexcept
+   {
+      return Iterator(*this, 0);
+   }
+
+   Iterator end() const noexcept
+   {
+      return Iterator(*this, fNumObjects);
+   }
+
+private:
+   T* ObjectAt(int index) const noexcept
+   {
+      return reinterpret_cast<T*>(fObjects + index * fStride + fOffset);
+   }
+
+   void Swap(FactoryBatch& other) noexcept
+   {
+      fStorage.swapWith(other.fStorage);
+      std::swap(fObjects, other.fObjects);
+      std::swap(fStride, other.fStride);
+      std::swap(fOffset, other.fOffset);
+      std::swap(fNumObjects, other.fNumObjects);
+   }
+
+   HeapBlock<char> fStorage;
+   /// the first object, aligned as the type needs.
+   char* fObjects;
+   size_t fStride;
+   /// where the `T` is in each object.
+   ptrdiff_t fOffset;
+   int fNumObjects;
+
+   JUCE_DECLARE_NON_COPYABLE(FactoryBatch)
+};
+
+
+#endif  // FACTORYBATCH_H_INCLUDED
@@ -25,12 +25,21 @@
 
 #include "factoryDatabase.h"
 
-template <class T>
+/**
+ * @class FactoryBuildable
+ * @brief Mix-in base for a class hierarchy that can be created by name.
+ *
+ * `LockType` picks how the hierarchy's FactoryDatabase is protected against 
+ * being used from several threads at once; see factoryLocks.h.
+ */
+template <class T, class LockType = DummyCriticalSection>
 class FactoryBuildable 
 {
 public:
+   typedef FactoryDatabase<T, LockType> Database;
+
    FactoryBuildable()
-   :  fTypeName("!!UNKNOWN!!")
+   :  fDescriptor(nullptr)
    {
       
    };
@@ -38,14 +47,116 @@ public:
    virtual ~FactoryBuildable() {};
    
    /**
-    * Retuired for the factory -- set the typename used to create an object. By 
-    * storing it redundantly in each object we can easily make sure that we 
-    * persist each object derived from Base correctly.
-    * @param name Name of this type, which may not match the C++ class name.
+    * Required for the factory -- point the object at the descriptor of the 
+    * type used to create it. By keeping this in each object we can easily 
+    * make sure that we persist each object derived from Base correctly.
+    * @param descriptor Descriptor owned by the object's factory.
+    */
+   void SetDescriptor(const FactoryDescriptor<T>* descriptor) noexcept
+   {
+      fDescriptor = descriptor;
+   }
+
+   /**
+    * Put the object back into the state that it was in when it was created, 
+    * so that it can be recycled. Override this if your class has state, and 
+    * keep any memory that it has allocated (e.g. using 
+    * `Array::clearQuick()`) -- not having to allocate it again is the point 
+    * of recycling.
+    */
+   virtual void Reset() 
+   {
+
+   }
+
+   /**
+    * Set the object up from the properties of a config tree, after it's 
+    * been created by `Create(const ValueTree&)`. The default does nothing. 
+    * Use a static ConfigSchema to read the properties without building 
+    * Identifiers from strings each time.
+    * @param config The tree that the object was created from.
     */
-   void SetTypeName(StringRef name)
+   virtual void Configure(const ValueTree& /*config*/) 
    {
-      fTypeName = name;
+
+   }
+
+   /**
+    * Make a copy of this object using the factory that created it, without 
+    * looking anything up by name. The copy is allocated the same way as the 
+    * original (e.g. from the same pool).
+    * @return The copy, or nullptr if this object wasn't created by a factory 
+    *         or its class can't be copied.
+    */
+   T* Clone() const
+   {
+      jassert(nullptr != fDescriptor);
+      T* retval = nullptr;
+      if (nullptr != fDescriptor)
+      {
+         retval = fDescriptor->GetFactory()->Clone(static_cast<const T&>(*this));
+      }
+      return retval;
+   }
+
+   /**
+    * Create a new object of the same type as this one, as if it had been 
+    * created by name, without looking the name up.
+    * @return The new object, or nullptr if this object wasn't created by a 
+    *         factory or its class needs constructor arguments.
+    */
+   T* CloneSameType() const
+   {
+      jassert(nullptr != fDescriptor);
+      T* retval = nullptr;
+      if (nullptr != fDescriptor)
+      {
+         retval = fDescriptor->GetFactory()->TakeOrCreate();
+      }
+      return retval;
+   }
+
+   /**
+    * @return The factory that created this object, or nullptr if it wasn't 
+    *         created by a factory.
+    */
+   BaseFactory<T>* GetFactory() const noexcept
+   {
+      return (nullptr != fDescriptor) ? fDescriptor->GetFactory() : nullptr;
+   }
+
+   /**
+    * @return Hash of this object's type name (the same value as 
+    *         `TypeNameHash::Calculate(GetTypeName())`), or 0 if it wasn't 
+    *         created by a factory.
+    */
+   uint64 GetTypeId() const noexcept
+   {
+      return (nullptr != fDescriptor) ? fDescriptor->GetHash() : 0;
+   }
+
+   /**
+    * @return The descriptor of the type this object was created as, or 
+    *         nullptr if it wasn't created by a factory.
+    */
+   const FactoryDescriptor<T>* GetDescriptor() const noexcept
+   {
+      return fDescriptor;
+   }
+
+   /**
+    * @return The name used to create this object, which may not match the 
+    *         C++ class name. Objects that weren't created by a factory 
+    *         return "!!UNKNOWN!!".
+    */
+   const String& GetTypeName() const noexcept
+   {
+      if (nullptr != fDescriptor)
+      {
+         return fDescriptor->GetTypeName();
+      }
+      static const String kUnknown("!!UNKNOWN!!");
+      return kUnknown;
    }
 
    /**
@@ -58,10 +169,12 @@ public:
     *                the same as the actual C++ class name)
     * @param factory Pointer to a BaseFactory object that will return an instance
     *                of the Base class.
+    * @return        false if the factory can't be used; see 
+    *                `FactoryDatabase::RegisterFactory()`.
     */
-   static void RegisterFactory(StringRef name, BaseFactory<T>* factory)
+   static bool RegisterFactory(StringRef name, BaseFactory<T>* factory)
    {
-      FactoryDatabase<T>::RegisterFactory(name, factory);
+      return Database::RegisterFactory(name, factory);
    }   
    /**
     * Create a Base object using its name.
@@ -71,12 +184,372 @@ public:
     */  
    static T* Create(StringRef name)
    {
-      return FactoryDatabase<T>::Create(name);
+      return Database::Create(name);
    }   
+
+   /**
+    * Look up the factory for a type name once so that it can be used for 
+    * repeated calls to `Create()` without any string handling.
+    * @param  name Name of the Base class you'd like to create.
+    * @return      A handle to that class's factory (invalid if the name is
+    *              unknown).
+    */
+   static FactoryHandle<T> Resolve(StringRef name)
+   {
+      return Database::Resolve(name);
+   }
+
+   static FactoryHandle<T> Resolve(const TypeName& name)
+   {
+      return Database::Resolve(name);
+   }
+
+   /**
+    * Create a Base object using a name that was hashed at compile time. 
+    * @param  name Name of the Base class you'd like to create.
+    * @return      A pointer to the object, or `nullptr`.
+    */
+   static T* Create(const TypeName& name)
+   {
+      return Database::Create(name);
+   }
+
+   /**
+    * Create a Base object whose type name is a compile-time constant:
+    * ```
+    * constexpr TypeName kSmaller("smaller");
+    * Base* s = Base::Create<kSmaller>();
+    * ```
+    * The factory is resolved the first time each instantiation of this 
+    * function is called and reused after that, so the type has to be 
+    * registered by then (i.e. don't call this during static initialization).
+    * @return A pointer to the object, or `nullptr` if the name is unknown.
+    */
+   template <const TypeName& kName>
+   static T* Create()
+   {
+      static const FactoryHandle<T> handle = Database::Resolve(kName);
+      return Database::Create(handle);
+   }
+
+   /**
+    * Create a Base object using a handle returned from `Resolve()`.
+    * @param  handle Handle to the factory for the class you'd like to create.
+    * @return        A pointer to the new object, or `nullptr` if the handle
+    *                is invalid.
+    */
+   static T* Create(const FactoryHandle<T>& handle)
+   {
+      return Database::Create(handle);
+   }
+
+   /**
+    * Create a Base object on a thread pool and pass it to `callback`, on 
+    * the pool's thread or the message thread. See 
+    * FactoryDatabase::CreateAsync().
+    * @return false (without calling `callback`) if the name is unknown.
+    */
+   static bool CreateAsync(StringRef name, ThreadPool& pool, 
+      typename Database::CreateCallback callback, 
+      AsyncDelivery delivery = AsyncDelivery::kPoolThread)
+   {
+      return Database::CreateAsync(name, pool, callback, delivery);
+   }
+
+   static bool CreateAsync(const TypeName& name, ThreadPool& pool, 
+      typename Database::CreateCallback callback, 
+      AsyncDelivery delivery = AsyncDelivery::kPoolThread)
+   {
+      return Database::CreateAsync(name, pool, callback, delivery);
+   }
+
+   static bool CreateAsync(const ValueTree& config, ThreadPool& pool, 
+      typename Database::CreateCallback callback, 
+      AsyncDelivery delivery = AsyncDelivery::kPoolThread)
+   {
+      return Database::CreateAsync(config, pool, callback, delivery);
+   }
+
+   static bool CreateAsync(const FactoryHandle<T>& handle, const ValueTree& config, 
+      ThreadPool& pool, typename Database::CreateCallback callback, 
+      AsyncDelivery delivery = AsyncDelivery::kPoolThread)
+   {
+      return Database::CreateAsync(handle, config, pool, callback, delivery);
+   }
+
+   /**
+    * Create a Base object on a thread pool, and get it through a future.
+    */
+   static std::future<FactoryPtr<T> > CreateFuture(StringRef name, ThreadPool& pool)
+   {
+      return Database::CreateFuture(name, pool);
+   }
+
+   static std::future<FactoryPtr<T> > CreateFuture(const TypeName& name, ThreadPool& pool)
+   {
+      return Database::CreateFuture(name, pool);
+   }
+
+   static std::future<FactoryPtr<T> > CreateFuture(const ValueTree& config, ThreadPool& pool)
+   {
+      return Database::CreateFuture(config, pool);
+   }
+
+   static std::future<FactoryPtr<T> > CreateFuture(const FactoryHandle<T>& handle, 
+      const ValueTree& config, ThreadPool& pool)
+   {
+      return Database::CreateFuture(handle, config, pool);
+   }
+
+   /**
+    * Create a list of objects of mixed types in parallel on a thread pool, 
+    * returning them in the order of their names (or of the children of a 
+    * tree of config specs). See FactoryDatabase::CreateMany().
+    */
+   static std::vector<FactoryPtr<T> > CreateMany(const StringArray& names, ThreadPool& pool)
+   {
+      return Database::CreateMany(names, pool);
+   }
+
+   static std::vector<FactoryPtr<T> > CreateMany(const ValueTree& specs, ThreadPool& pool)
+   {
+      return Database::CreateMany(specs, pool);
+   }
+
+   /**
+    * Create objects of a type ahead of time on a thread pool, so that 
+    * `Create()` can hand them out without constructing anything. See 
+    * FactoryDatabase::Prewarm().
+    * @param  name  Name of the Base class to create.
+    * @param  count Number of objects to create.
+    * @param  pool  Thread pool to do the work on.
+    * @return       false if the name is unknown.
+    */
+   static bool Prewarm(StringRef name, int count, ThreadPool& pool)
+   {
+      return Database::Prewarm(name, count, pool);
+   }
+
+   static int Prewarm(const HashMap<String, int>& counts, ThreadPool& pool)
+   {
+      return Database::Prewarm(counts, pool);
+   }
+
+   /**
+    * Delete any prewarmed or recycled objects of a type that are waiting to 
+    * be handed out.
+    */
+   static void DiscardPrewarmed(StringRef name)
+   {
+      Database::DiscardPrewarmed(name);
+   }
+
+   /**
+    * Let a type's factory keep up to `maxCached` released objects to hand 
+    * out again instead of constructing new ones:
+    * ```
+    * Base::SetRecycling("smaller", 64);
+    * FactoryPtr<Base> s = Base::CreateUnique("smaller");
+    * s = nullptr;                     // s->Reset() is called, and s is kept
+    * s = Base::CreateUnique("smaller");   // the same object again
+    * ```
+    * Objects are recycled when they're released by a `CreateUnique()` 
+    * pointer or with `Release()`, but not when they're deleted.
+    * @return false if the name is unknown.
+    */
+   static bool SetRecycling(StringRef name, int maxCached)
+   {
+      return Database::SetRecycling(name, maxCached);
+   }
+
+   static RecycleStats GetRecycleStats(StringRef name)
+   {
+      return Database::GetRecycleStats(name);
+   }
+
+   /**
+    * Give back an object created by `Create()`, recycling it if its type 
+    * allows that, or deleting it.
+    */
+   static void Release(T* object)
+   {
+      Database::Release(object);
+   }
+
+   /**
+    * Find out how big a type is and how it has to be aligned, so that you 
+    * can provide storage for `CreateAt()`.
+    * @param  name Name of the Base class you'd like to create.
+    * @return      The class's size and alignment, or zeros if the name is 
+    *              unknown.
+    */
+   static FactoryLayout GetLayout(StringRef name)
+   {
+      return Database::GetLayout(name);
+   }
+
+   static FactoryLayout GetLayout(const TypeName& name)
+   {
+      return Database::GetLayout(name);
+   }
+
+   static FactoryLayout GetLayout(const FactoryHandle<T>& handle)
+   {
+      return Database::GetLayout(handle);
+   }
+
+   /**
+    * Construct a Base object in storage that you provide:
+    * ```
+    * alignas(16) char buffer[128];
+    * jassert(Base::GetLayout("smaller").size <= sizeof(buffer));
+    * Base* s = Base::CreateAt("smaller", buffer);
+    * ...
+    * s->~Base();
+    * ```
+    * @param  name   Name of the Base class you'd like to create.
+    * @param  buffer Storage that's big enough and aligned as `GetLayout()`
+    *                requires.
+    * @return        A pointer to the object, or `nullptr`.
+    */
+   static T* CreateAt(StringRef name, void* buffer)
+   {
+      return Database::CreateAt(name, buffer);
+   }
+
+   static T* CreateAt(const TypeName& name, void* buffer)
+   {
+      return Database::CreateAt(name, buffer);
+   }
+
+   static T* CreateAt(const FactoryHandle<T>& handle, void* buffer)
+   {
+      return Database::CreateAt(handle, buffer);
+   }
+
+   /**
+    * Create many Base objects of one type in a single allocation.
+    * @param  name  Name of the Base class you'd like to create.
+    * @param  count Number of objects to create.
+    * @return       A FactoryBatch that owns the objects (empty if the name 
+    *               is unknown).
+    */
+   static FactoryBatch<T> CreateBatch(StringRef name, int count)
+   {
+      return Database::CreateBatch(name, count);
+   }
+
+   static FactoryBatch<T> CreateBatch(const TypeName& name, int count)
+   {
+      return Database::CreateBatch(name, count);
+   }
+
+   static FactoryBatch<T> CreateBatch(const FactoryHandle<T>& handle, int count)
+   {
+      return Database::CreateBatch(handle, count);
+   }
+
+   /**
+    * Create a Base object from a config tree whose `type` property is the 
+    * type name, and pass the tree to the object's `Configure()`:
+    * ```
+    * ValueTree config("node");
+    * config.setProperty("type", "sized", nullptr);
+    * config.setProperty("size", 64, nullptr);
+    * ScopedPointer<Base> s = Base::Create(config);
+    * ```
+    * @return The new object, or `nullptr` if the type is missing or unknown.
+    */
+   static T* Create(const ValueTree& config)
+   {
+      return Database::Create(config);
+   }
+
+   static T* Create(const FactoryHandle<T>& handle, const ValueTree& config)
+   {
+      return Database::Create(handle, config);
+   }
+
+   /**
+    * Create a Base object, passing arguments to its constructor so that it's 
+    * built with its final state:
+    * ```
+    * static Factory<Base, Sized, int> sizedFactory("sized");
+    * ...
+    * Base* s = Base::CreateWith<int>("sized", 64);
+    * ```
+    * `Args` must match the argument types that the type's Factory was 
+    * declared with. That's checked at run time, not by the compiler.
+    * @return The new object, or `nullptr` if the name is unknown or its 
+    *         factory doesn't take these arguments.
+    */
+   template <class... Args, class... Params>
+   static T* CreateWith(StringRef name, Params&&... params)
+   {
+      return Database::template CreateWith<Args...>(name, std::forward<Params>(params)...);
+   }
+
+   template <class... Args, class... Params>
+   static T* CreateWith(const TypeName& name, Params&&... params)
+   {
+      return Database::template CreateWith<Args...>(name, std::forward<Params>(params)...);
+   }
+
+   template <class... Args, class... Params>
+   static T* CreateWith(const FactoryHandle<T>& handle, Params&&... params)
+   {
+      return Database::template CreateWith<Args...>(handle, std::forward<Params>(params)...);
+   }
+
+   /**
+    * Create a Base object owned by a `std::unique_ptr`, which will release 
+    * it using whatever allocator its factory used: 
+    * ```
+    * FactoryPtr<Base> s = Base::CreateUnique("smaller");
+    * ```
+    * @param  name Name of the Base class you'd like to create.
+    * @return      The new object, or an empty pointer.
+    */
+   static FactoryPtr<T> CreateUnique(StringRef name)
+   {
+      return Database::CreateUnique(name);
+   }
+
+   static FactoryPtr<T> CreateUnique(const TypeName& name)
+   {
+      return Database::CreateUnique(name);
+   }
+
+   static FactoryPtr<T> CreateUnique(const FactoryHandle<T>& handle)
+   {
+      return Database::CreateUnique(handle);
+   }
+
+   /**
+    * Create a Base object inside an ObjectArena, which owns it and will 
+    * destroy it when the arena is reset.
+    * @param  name  Name of the Base class you'd like to create.
+    * @param  arena Arena to create the object in.
+    * @return       A pointer to the object, or `nullptr`.
+    */
+   static T* Create(StringRef name, ObjectArena& arena)
+   {
+      return Database::Create(name, arena);
+   }
+
+   static T* Create(const TypeName& name, ObjectArena& arena)
+   {
+      return Database::Create(name, arena);
+   }
+
+   static T* Create(const FactoryHandle<T>& handle, ObjectArena& arena)
+   {
+      return Database::Create(handle, arena);
+   }
    
 
 private:
-   String fTypeName;
+   const FactoryDescriptor<T>* fDescriptor;
    
 };
 
@@ -25,6 +25,93 @@
 #define FACTORYDATABASE_H_INCLUDED
 
 #include "factory.h"
+#include "factoryBatch.h"
+#include "factoryLocks.h"
+#include "factoryRecord.h"
+#include "frozenFactoryTable.h"
+#include "snapshotPointer.h"
+#include "typeName.h"
+
+#include <functional>
+#include <future>
+#include <vector>
+
+/**
+ * @class FactoryHandle
+ *
+ * @brief A pre-resolved reference to one of the factories registered in a 
+ *        FactoryDatabase. 
+ *
+ * Looking a factory up by name means building a String from the name and 
+ * hashing it on every call. Code that creates the same types over and over 
+ * can instead call `Resolve()` once, hang on to the handle, and then create 
+ * objects through it without doing any string work or allocation beyond the 
+ * object itself:
+ * ```
+ * static const FactoryHandle<Base> kSmaller = Base::Resolve("smaller");
+ * ScopedPointer<Base> s = Base::Create(kSmaller);
+ * ```
+ * Handles stay valid for as long as the factory object they refer to exists, 
+ * which for the usual case of factories declared at file scope is the 
+ * lifetime of the program. A handle that was resolved from an unknown name 
+ * is 'null' and will create `nullptr`s.
+ */
+template <class T>
+class FactoryHandle
+{
+public:
+   FactoryHandle()
+   :  fFactory(nullptr)
+   {
+
+   }
+
+   explicit FactoryHandle(BaseFactory<T>* factory)
+   :  fFactory(factory)
+   {
+
+   }
+
+   /**
+    * @return true if this handle refers to a registered factory.
+    */
+   bool IsValid() const noexcept
+   {
+      return (nullptr != fFactory);
+   }
+
+   /**
+    * @return the factory this handle refers to, or nullptr.
+    */
+   BaseFactory<T>* GetFactory() const noexcept
+   {
+      return fFactory;
+   }
+
+   bool operator==(const FactoryHandle& other) const noexcept
+   {
+      return fFactory == other.fFactory;
+   }
+
+   bool operator!=(const FactoryHandle& other) const noexcept
+   {
+      return fFactory != other.fFactory;
+   }
+
+private:
+   BaseFactory<T>* fFactory;
+};
+
+
+/**
+ * Which thread `FactoryDatabase::CreateAsync()` hands new objects over on.
+ */
+enum class AsyncDelivery
+{
+   kPoolThread,      ///< the thread pool's thread that created the object
+   kMessageThread    ///< the message thread, via `MessageManager::callAsync()`
+};
+
 
 /**
  * @class FactoryDatabase
@@ -43,40 +130,65 @@
  *
  * **Boom.** 
  *
- * We use an approach here know variously as a 'nifty counter' or 
- * 'Schwarz counter' which you can Google as well as I did. Short version is 
- * that we make use of some guaranteed aspects of static variables declared
- * in header files to ensure that the database here is ready to go before anyone
- * attempts to actually use it. 
+ * So the map (along with the frozen table and the lock) lives in a 
+ * function-local static, which is created the first time anything -- a 
+ * registration or a lookup -- needs it, however early in static 
+ * initialization that is, and is destroyed after every Factory object that 
+ * registered with it. The static members that are left are all constant 
+ * initialized, so a hierarchy adds no code of its own to the program's 
+ * startup; a hierarchy whose types are all FactoryRecords runs nothing at 
+ * all before `main()`.
+ *
+ * After static initialization is complete (e.g. at the top of `main()`), you
+ * can call `Freeze()` to compile the database into a FrozenFactoryTable, 
+ * which `Create()` and `Resolve()` will then use instead of the HashMap. Any
+ * factories registered after that point cause the frozen table to be rebuilt.
+ *
+ * Lookups and registrations are protected by a lock of type `LockType` (see 
+ * factoryLocks.h for the choices). With the default DummyCriticalSection 
+ * nothing is locked, so neither the HashMap nor the frozen table is safe to 
+ * use while another thread is registering a factory. If that's going to 
+ * happen (plugins loaded on a background thread, for instance) either pick a 
+ * real lock, or call `EnableConcurrentAccess()` before starting any other 
+ * threads. In concurrent mode readers ignore `LockType` and use the frozen 
+ * table through a SnapshotPointer: each lookup is one atomic load plus an 
+ * uncontended per-thread counter, and each registration publishes a rebuilt
+ * table, so readers never block and never see a half-updated database.
  *
- * Any cpp file that includes this will have a static instance of this class 
- * brought in (but the ctor/dtor only do anything on their first/last entrance/
- * exit)
+ * Code that keeps creating the same few types by name from several threads 
+ * can also call `EnableThreadCache()`. Each thread then remembers the last 
+ * few factories it looked up, and only goes to the shared database (and its 
+ * lock) on a miss. Every registration bumps a generation counter that 
+ * empties all of the caches.
  *
- * See the NodeFactoryDatabase instantiation for an example.
+ * Each specialization of this class needs storage for its static members; 
+ * put 
+ * ```
+ * FACTORY_DATABASE_STORAGE(MyBase::Database)
+ * ```
+ * in exactly one cpp file. 
+ *
+ * Types can also be registered without any static initialization at all, 
+ * using `FACTORY_RECORD()` (see factoryRecord.h); their hierarchy uses 
+ * `FACTORY_DATABASE_STORAGE_WITH_RECORDS()` instead. A recorded type's 
+ * factory is created the first time its name is looked up, and is never 
+ * put in the HashMap (or a frozen table); it's always found through its 
+ * record, and lookups check the records before the HashMap.
  */
 
 
-template <class T>
+template <class T, class LockType = DummyCriticalSection>
 class FactoryDatabase
 {
 public:
-   FactoryDatabase()
-   {
-      if (0 == fCount++)
-      {
-         fDatabase = new HashMap<String, BaseFactory<T>* >();
-      }
-   }
-   ~FactoryDatabase()
-   {
-      if (0 == --fCount)
-      {
-         delete fDatabase;
-         fDatabase = nullptr;
-      }
-   }
-   
+   typedef T Node;
+   typedef HashMap<String, BaseFactory<T>* > Map;
+   typedef std::function<void(FactoryPtr<T>)> CreateCallback;
+   typedef LockType LockTypeToUse;
+   typedef SnapshotPointer<FrozenFactoryTable<T> > FrozenSnapshots;
+   typedef typename FactoryLockTraits<LockType>::ScopedReadLock ScopedReadLock;
+   typedef typename FactoryLockTraits<LockType>::ScopedWriteLock ScopedWriteLock;
+
    /**
     * Register a Node Factory object with a name that can be used to create 
     * Node objects at run time. 
@@ -84,36 +196,1176 @@ public:
     *                the same as the actual C++ class name)
     * @param factory Pointer to a NodeFactory object that will return an instance
     *                of the Node class.
+    * @return        false if the factory can't be used. That only happens once 
+    *                concurrent access is enabled and no frozen table can be 
+    *                built that includes the new name (e.g. its hash collides 
+    *                with another name); the database is left unchanged. 
+    *                Without concurrent access a failed rebuild thaws the 
+    *                database, and lookups go back to the HashMap.
     */
-   static void RegisterFactory(StringRef name, BaseFactory<T>* factory)
+   static bool RegisterFactory(StringRef name, BaseFactory<T>* factory)
    {
-      jassert(fDatabase);
+      // a recorded name is always found through its record, so a factory 
+      // registered with the same name would never be used.
+      jassert(fRecordsBegin == fRecordsEnd || nullptr == GetRecordIndex().Find(
+         name.text.getAddress(), name.text.sizeInBytes() - 1, TypeNameHash::Calculate(name)));
       DBG("Registering factory for " << name);
-      fDatabase->set(name, factory);
+      Storage& storage = GetStorage();
+      const ScopedWriteLock wl(storage.lock);
+      const ScopedLock sl(storage.frozen.GetWriterLock());
+      const String key(name);
+      const bool replacing = storage.database.contains(key);
+      BaseFactory<T>* const previous = storage.database[key];
+      storage.database.set(key, factory);
+      // a late registration -- the frozen table needs to know about it.
+      if (IsFrozen() && ! Rebuild() && IsConcurrent())
+      {
+         // readers only ever see the published table, which doesn't have 
+         // this factory, so put the HashMap back the way they see it.
+         jassertfalse;
+         if (replacing)
+         {
+            storage.database.set(key, previous);
+         }
+         else
+         {
+            storage.database.remove(key);
+         }
+         return false;
+      }
+      // bump the generation after publishing so that a thread cache can't 
+      // refill from the old table under the new generation.
+      fGeneration.fetch_add(1, std::memory_order_release);
+      return true;
    }   
+
+   /**
+    * Compile the current contents of the database into a read-only perfect 
+    * hash table that will be used for all lookups from now on. Call this 
+    * once all of the factories you expect to use have been registered.
+    * Calling it again rebuilds the table.
+    * @return true if the table was built.
+    */
+   static bool Freeze()
+   {
+      Storage& storage = GetStorage();
+      const ScopedWriteLock wl(storage.lock);
+      const ScopedLock sl(storage.frozen.GetWriterLock());
+      return Rebuild();
+   }
+
+   /**
+    * Discard the frozen table and go back to using the HashMap for lookups.
+    * Not possible once concurrent access is enabled.
+    */
+   static void Thaw()
+   {
+      Storage& storage = GetStorage();
+      const ScopedWriteLock wl(storage.lock);
+      const ScopedLock sl(storage.frozen.GetWriterLock());
+      jassert(! IsConcurrent());
+      if (! IsConcurrent())
+      {
+         storage.frozen.Publish(nullptr);
+      }
+   }
+
+   /**
+    * @return true if lookups are currently using a frozen table.
+    */
+   static bool IsFrozen()
+   {
+      return (nullptr != GetStorage().frozen.GetUnprotected());
+   }
+
+   /**
+    * Make the database safe to use while factories are being registered on 
+    * other threads. This freezes the database, and from then on every 
+    * registration publishes a new frozen table for readers to pick up, and 
+    * old tables are deleted once no reader can still be using them. 
+    *
+    * Call this before any other threads might be using the database; it 
+    * can't be turned off again.
+    * @return true if the database could be frozen.
+    */
+   static bool EnableConcurrentAccess()
+   {
+      if (! Freeze())
+      {
+         return false;
+      }
+      fConcurrent.store(true);
+      return true;
+   }
+
+   /**
+    * @return true if `EnableConcurrentAccess()` has been called.
+    */
+   static bool IsConcurrent()
+   {
+      return fConcurrent.load(std::memory_order_relaxed);
+   }
+
+   /**
+    * Delete any old frozen tables that readers have finished with. This 
+    * happens automatically whenever a factory is registered, so you should 
+    * only need this to release memory after a burst of registrations.
+    * @return the number of old tables that are still in use.
+    */
+   static int ReclaimSnapshots()
+   {
+      FrozenSnapshots& frozen = GetStorage().frozen;
+      const ScopedLock sl(frozen.GetWriterLock());
+      return frozen.Reclaim();
+   }
+
+   /**
+    * Create objects ahead of time on a thread pool, so that later calls to 
+    * `Create()` and `CreateUnique()` can hand them out immediately instead of
+    * paying for construction (and any page faults) on the caller's thread.
+    * This returns straight away; objects become available as the pool's 
+    * threads make them.
+    *
+    * The factories have to outlive the jobs, and any objects still waiting 
+    * at shutdown should be deleted with `DiscardPrewarmed()`.
+    * @param  name  Typename of the class to create.
+    * @param  count Number of objects to create.
+    * @param  pool  Thread pool to do the work on.
+    * @return       false if the name is unknown, or the type can only be 
+    *               created with constructor arguments.
+    */
+   static bool Prewarm(StringRef name, int count, ThreadPool& pool)
+   {
+      BaseFactory<T>* factory = Find(name);
+      if (nullptr == factory || ! factory->CanCreate())
+      {
+         return false;
+      }
+      // split the work up so that several threads can share it.
+      const int kObjectsPerJob = 256;
+      for (int start = 0; start < count; start += kObjectsPerJob)
+      {
+         pool.addJob(new PrewarmJob(*factory, jmin(kObjectsPerJob, count - start)), true);
+      }
+      return true;
+   }
+
+   /**
+    * Prewarm several types at once.
+    * @param  counts Number of objects to create for each type name.
+    * @param  pool   Thread pool to do the work on.
+    * @return        The number of names that were found.
+    */
+   static int Prewarm(const HashMap<String, int>& counts, ThreadPool& pool)
+   {
+      int retval = 0;
+      for (HashMap<String, int>::Iterator i(counts); i.next();)
+      {
+         if (Prewarm(i.getKey(), i.getValue(), pool))
+         {
+            ++retval;
+         }
+      }
+      return retval;
+   }
+
+   /**
+    * Delete any prewarmed or recycled objects of a type that are waiting to 
+    * be handed out.
+    * @param  name Typename of the class.
+    */
+   static void DiscardPrewarmed(StringRef name)
+   {
+      if (BaseFactory<T>* factory = Find(name))
+      {
+         factory->DiscardParked();
+      }
+   }
+
+   /**
+    * Turn recycling on or off for a type. See BaseFactory::SetRecycling().
+    * @param  name      Typename of the class.
+    * @param  maxCached The most released objects to keep for reuse, or 0 to
+    *                   turn recycling off.
+    * @return           false if the name is unknown.
+    */
+   static bool SetRecycling(StringRef name, int maxCached)
+   {
+      BaseFactory<T>* factory = Find(name);
+      if (nullptr == factory)
+      {
+         return false;
+      }
+      factory->SetRecycling(maxCached);
+      return true;
+   }
+
+   /**
+    * @param  name Typename of the class.
+    * @return      The type's recycling statistics, or all zeros if the name
+    *              is unknown.
+    */
+   static RecycleStats GetRecycleStats(StringRef name)
+   {
+      if (BaseFactory<T>* factory = Find(name))
+      {
+         return factory->GetRecycleStats();
+      }
+      RecycleStats unknown = { 0, 0, 0, 0, 0, 0 };
+      return unknown;
+   }
+
+   /**
+    * Give back an object that you're finished with, so that it can be 
+    * recycled if its type allows that. Objects that weren't created by a 
+    * factory are deleted.
+    */
+   static void Release(T* object)
+   {
+      if (nullptr != object && nullptr != object->GetDescriptor())
+      {
+         object->GetDescriptor()->GetFactory()->Release(object);
+      }
+      else
+      {
+         delete object;
+      }
+   }
+
+   /**
+    * Find out how much memory, aligned how, a type needs for `CreateAt()`.
+    * @param  name Typename of the class you'd like to create.
+    * @return      The type's layout, or all zeros if the name is unknown.
+    */
+   static FactoryLayout GetLayout(StringRef name)
+   {
+      return GetLayout(Resolve(name));
+   }
+
+   static FactoryLayout GetLayout(const TypeName& name)
+   {
+      return GetLayout(Resolve(name));
+   }
+
+   static FactoryLayout GetLayout(const FactoryHandle<T>& handle)
+   {
+      BaseFactory<T>* factory = handle.GetFactory();
+      if (factory)
+      {
+         return factory->GetDescriptor().GetLayout();
+      }
+      FactoryLayout unknown = { 0, 0 };
+      return unknown;
+   }
+
+   /**
+    * Construct a Node object in storage that you provide, which must be 
+    * at least as large and as strictly aligned as `GetLayout()` says. Destroy 
+    * the object by calling its destructor, not `delete`. 
+    * @param  name   Typename of the class you'd like to create.
+    * @param  buffer Where to construct it.
+    * @return        A pointer to the object (which may not be equal to 
+    *                `buffer` if `T` isn't the first base of the class), or 
+    *                `nullptr` if the name is unknown or the type needs 
+    *                constructor arguments.
+    */
+   static T* CreateAt(StringRef name, void* buffer)
+   {
+      return CreateAt(Resolve(name), buffer);
+   }
+
+   static T* CreateAt(const TypeName& name, void* buffer)
+   {
+      return CreateAt(Resolve(name), buffer);
+   }
+
+   static T* CreateAt(const FactoryHandle<T>& handle, void* buffer)
+   {
+      T* retval = nullptr;
+      BaseFactory<T>* factory = handle.GetFactory();
+      if (factory)
+      {
+         jassert(0 == reinterpret_cast<pointer_sized_uint>(buffer) 
+            % factory->GetDescriptor().GetAlignment());
+         retval = factory->CreateAt(buffer);
+      }
+      return retval;
+   }
+
+   /**
+    * Create `count` Node objects of the same type, next to each other in a 
+    * single block of memory. The name is only looked up once.
+    * @param  name  Typename of the class you'd like to create.
+    * @param  count Number of objects to create.
+    * @return       A batch that owns the objects, which is empty if the name
+    *               is unknown or the type needs constructor arguments.
+    */
+   static FactoryBatch<T> CreateBatch(StringRef name, int count)
+   {
+      return CreateBatch(Resolve(name), count);
+   }
+
+   static FactoryBatch<T> CreateBatch(const TypeName& name, int count)
+   {
+      return CreateBatch(Resolve(name), count);
+   }
+
+   static FactoryBatch<T> CreateBatch(const FactoryHandle<T>& handle, int count)
+   {
+      jassert(count >= 0);
+      BaseFactory<T>* factory = handle.GetFactory();
+      if (factory && factory->CanCreate() && count > 0)
+      {
+         return FactoryBatch<T>(*factory, count);
+      }
+      return FactoryBatch<T>();
+   }
+
+   /**
+    * Create a Node object owned by a `std::unique_ptr` whose deleter knows 
+    * how the object's factory allocated it, so it will always be released 
+    * correctly.
+    * @param  name Typename of the class you'd like to create.
+    * @return      The new object, or an empty pointer.
+    */
+   static FactoryPtr<T> CreateUnique(StringRef name)
+   {
+      return CreateUnique(Resolve(name));
+   }
+
+   static FactoryPtr<T> CreateUnique(const TypeName& name)
+   {
+      return CreateUnique(Resolve(name));
+   }
+
+   static FactoryPtr<T> CreateUnique(const FactoryHandle<T>& handle)
+   {
+      BaseFactory<T>* factory = handle.GetFactory();
+      if (factory)
+      {
+         return factory->CreateUnique();
+      }
+      return FactoryPtr<T>();
+   }
+
+   /**
+    * Create a Node object, passing arguments to its constructor. The type 
+    * has to have been registered with a factory for exactly these 
+    * constructor argument types (see Factory):
+    * ```
+    * Base* s = Database::CreateWith<int, const String&>("sized", 64, "label");
+    * ```
+    * This is checked when it's called, not when it's compiled: the factory 
+    * is found by name and then cast to `FactoryWith<T, Args...>`, and a type 
+    * that was registered with different arguments gives `nullptr` (and an 
+    * assertion).
+    * @param  name   Typename of the class you'd like to create.
+    * @param  params Arguments for the constructor, converted to `Args`.
+    * @return        The new object, or `nullptr` if the name is unknown or 
+    *                its factory doesn't take these arguments.
+    */
+   template <class... Args, class... Params>
+   static T* CreateWith(StringRef name, Params&&... params)
+   {
+      return CreateWith<Args...>(Resolve(name), std::forward<Params>(params)...);
+   }
+
+   template <class... Args, class... Params>
+   static T* CreateWith(const TypeName& name, Params&&... params)
+   {
+      return CreateWith<Args...>(Resolve(name), std::forward<Params>(params)...);
+   }
+
+   template <class... Args, class... Params>
+   static T* CreateWith(const FactoryHandle<T>& handle, Params&&... params)
+   {
+      T* retval = nullptr;
+      BaseFactory<T>* factory = handle.GetFactory();
+      FactoryWith<T, Args...>* creator = dynamic_cast<FactoryWith<T, Args...>*>(factory);
+      // the type is registered, but not with these constructor arguments.
+      jassert(nullptr == factory || nullptr != creator);
+      if (creator)
+      {
+         retval = creator->CreateWith(std::forward<Params>(params)...);
+      }
+      return retval;
+   }
+
+   /**
+    * Create a Node object from a config tree. The type is read from the 
+    * tree's `type` property, and the new object's `Configure()` is called 
+    * with the tree so that it can set itself up from the other properties.
+    * @param  config Tree with at least a `type` property.
+    * @return        The new object, or `nullptr` if the tree has no type or 
+    *                the type is unknown.
+    */
+   static T* Create(const ValueTree& config)
+   {
+      return Create(Resolve(config), config);
+   }
+
+   /**
+    * @return A handle to the factory named by a config tree's `type` 
+    *         property (invalid if it doesn't have one, or it's unknown).
+    */
+   static FactoryHandle<T> Resolve(const ValueTree& config)
+   {
+      static const Identifier kType("type");
+      const var& type = config[kType];
+      if (type.isString())
+      {
+         return Resolve(type.toString());
+      }
+      return FactoryHandle<T>();
+   }
+
+   /**
+    * Create a Node object of a type that was resolved ahead of time, and 
+    * configure it from `config` (whose `type` property is ignored).
+    */
+   static T* Create(const FactoryHandle<T>& handle, const ValueTree& config)
+   {
+      T* retval = Create(handle);
+      if (retval)
+      {
+         retval->Configure(config);
+      }
+      return retval;
+   }
+
+   /**
+    * Create a Node object on a thread pool, for types whose constructors 
+    * are too slow to run on a thread that mustn't block, and pass it to 
+    * `callback` when it's ready:
+    * ```
+    * Database::CreateAsync("texture", pool, [this] (FactoryPtr<Base> t)
+    * {
+    *    fTexture = std::move(t);
+    * }, AsyncDelivery::kMessageThread);
+    * ```
+    * The callback is called on the pool's thread, or on the message thread 
+    * (using `MessageManager::callAsync()`) for kMessageThread. If the pool 
+    * is deleted before the job runs, the callback isn't called at all.
+    * @param  name     Typename of the class you'd like to create.
+    * @param  pool     Pool to create the object on.
+    * @param  callback Function that takes ownership of the new object.
+    * @param  delivery Which thread to call `callback` on.
+    * @return false (without calling `callback`) if the name is unknown.
+    */
+   static bool CreateAsync(StringRef name, ThreadPool& pool, CreateCallback callback, 
+      AsyncDelivery delivery = AsyncDelivery::kPoolThread)
+   {
+      return CreateAsync(Resolve(name), ValueTree(), pool, callback, delivery);
+   }
+
+   static bool CreateAsync(const TypeName& name, ThreadPool& pool, CreateCallback callback, 
+      AsyncDelivery delivery = AsyncDelivery::kPoolThread)
+   {
+      return CreateAsync(Resolve(name), ValueTree(), pool, callback, delivery);
+   }
+
+   /**
+    * Create a Node object from a config tree on a thread pool, calling its 
+    * `Configure()` there too. Don't change the tree until the object has 
+    * been delivered.
+    */
+   static bool CreateAsync(const ValueTree& config, ThreadPool& pool, 
+      CreateCallback callback, AsyncDelivery delivery = AsyncDelivery::kPoolThread)
+   {
+      return CreateAsync(Resolve(config), config, pool, callback, delivery);
+   }
+
+   static bool CreateAsync(const FactoryHandle<T>& handle, const ValueTree& config, 
+      ThreadPool& pool, CreateCallback callback, 
+      AsyncDelivery delivery = AsyncDelivery::kPoolThread)
+   {
+      BaseFactory<T>* factory = handle.GetFactory();
+      if (factory)
+      {
+         pool.addJob(new CreateJob(*factory, config, callback, delivery), true);
+         return true;
+      }
+      return false;
+   }
+
+   /**
+    * Create a Node object on a thread pool, and get it through a future:
+    * ```
+    * std::future<FactoryPtr<Base> > texture = Database::CreateFuture("texture", pool);
+    * ...
+    * FactoryPtr<Base> t = texture.get();
+    * ```
+    * @return A future for the new object. It holds an empty pointer if the 
+    *         name is unknown, and a `std::future_error` if the pool was 
+    *         deleted before the object was created.
+    */
+   static std::future<FactoryPtr<T> > CreateFuture(StringRef name, ThreadPool& pool)
+   {
+      return CreateFuture(Resolve(name), ValueTree(), pool);
+   }
+
+   static std::future<FactoryPtr<T> > CreateFuture(const TypeName& name, ThreadPool& pool)
+   {
+      return CreateFuture(Resolve(name), ValueTree(), pool);
+   }
+
+   static std::future<FactoryPtr<T> > CreateFuture(const ValueTree& config, ThreadPool& pool)
+   {
+      return CreateFuture(Resolve(config), config, pool);
+   }
+
+   static std::future<FactoryPtr<T> > CreateFuture(const FactoryHandle<T>& handle, 
+      const ValueTree& config, ThreadPool& pool)
+   {
+      // std::function needs a copyable callback, so the promise is shared.
+      std::shared_ptr<std::promise<FactoryPtr<T> > > promise = 
+         std::make_shared<std::promise<FactoryPtr<T> > >();
+      std::future<FactoryPtr<T> > retval = promise->get_future();
+      if (! CreateAsync(handle, config, pool, [promise] (FactoryPtr<T> object)
+         {
+            promise->set_value(std::move(object));
+         }))
+      {
+         promise->set_value(FactoryPtr<T>());
+      }
+      return retval;
+   }
+
+   /**
+    * Create a list of objects of mixed types, spreading the work across a 
+    * thread pool (and the calling thread), and return them in the same 
+    * order as their names:
+    * ```
+    * std::vector<FactoryPtr<Base> > objects = Database::CreateMany(names, pool);
+    * ```
+    * Each distinct name is only looked up once. 
+    * @param  names Typenames of the classes to create, repeated as needed.
+    * @param  pool  Pool to create the objects on. This waits for them.
+    * @return One object per name, with an empty pointer for each unknown 
+    *         name.
+    */
+   static std::vector<FactoryPtr<T> > CreateMany(const StringArray& names, ThreadPool& pool)
+   {
+      HashMap<String, BaseFactory<T>*> resolved;
+      Array<BaseFactory<T>*> factories;
+      factories.ensureStorageAllocated(names.size());
+      for (const String& name : names)
+      {
+         factories.add(ResolveOnce(name, resolved));
+      }
+      return CreateMany(factories, Array<ValueTree>(), pool);
+   }
+
+   /**
+    * Create an object for each child of `specs`, using the child as a 
+    * config tree (see `Create(const ValueTree&)`), across a thread pool. 
+    * Each object's `Configure()` is called on the pool too, so don't change 
+    * the trees until this returns.
+    * @return One object per child, with an empty pointer for each child 
+    *         whose type is missing or unknown.
+    */
+   static std::vector<FactoryPtr<T> > CreateMany(const ValueTree& specs, ThreadPool& pool)
+   {
+      static const Identifier kType("type");
+      HashMap<String, BaseFactory<T>*> resolved;
+      Array<BaseFactory<T>*> factories;
+      Array<ValueTree> configs;
+      factories.ensureStorageAllocated(specs.getNumChildren());
+      configs.ensureStorageAllocated(specs.getNumChildren());
+      for (int i = 0; i < specs.getNumChildren(); ++i)
+      {
+         const ValueTree config = specs.getChild(i);
+         const var& type = config[kType];
+         factories.add(type.isString() ? ResolveOnce(type.toString(), resolved) : nullptr);
+         configs.add(config);
+      }
+      return CreateMany(factories, configs, pool);
+   }
+
+   /**
+    * Create a Node object inside an arena. The arena owns the new object, 
+    * and destroys it when the arena is reset, so don't delete it yourself.
+    * @param  name  Typename of the class you'd like to create.
+    * @param  arena Arena to create the object in.
+    * @return       A pointer to the object, or `nullptr` if the name is 
+    *               unknown.
+    */
+   static T* Create(StringRef name, ObjectArena& arena)
+   {
+      return Create(Resolve(name), arena);
+   }
+
+   static T* Create(const TypeName& name, ObjectArena& arena)
+   {
+      return Create(Resolve(name), arena);
+   }
+
+   static T* Create(const FactoryHandle<T>& handle, ObjectArena& arena)
+   {
+      T* retval = nullptr;
+      BaseFactory<T>* factory = handle.GetFactory();
+      if (factory)
+      {
+         retval = factory->Create(arena);
+      }
+      return retval;
+   }
+
+   /**
+    * Turn the per-thread lookup cache on or off. While it's on, each thread 
+    * keeps its own small table of the factories that it has most recently 
+    * looked up by name, and checks that before touching anything shared.
+    * @param shouldEnable true to use the cache.
+    */
+   static void EnableThreadCache(bool shouldEnable)
+   {
+      fThreadCacheEnabled.store(shouldEnable);
+   }
+
+   /**
+    * @return true if lookups are using the per-thread cache.
+    */
+   static bool IsThreadCacheEnabled()
+   {
+      return fThreadCacheEnabled.load(std::memory_order_relaxed);
+   }
+
    /**
     * Create a Node object using its name.
     * @param  name Typename of the class you'd like to create.
     * @return      A pointer to the object if we have a registered factory
-    *              object that knows how to make it, or `nullptr`.
+    *              object that knows how to make it, or `nullptr` (which is 
+    *              also what types that need constructor arguments give).
     */    
    static T* Create(StringRef name)
    {
       T* retval = nullptr;
-      BaseFactory<T>* factory = (*fDatabase)[name];
+      BaseFactory<T>* factory = Find(name);
+      if (factory)
+      {
+         retval = factory->TakeOrCreate();
+      }
+      return retval;
+   }
+
+   /**
+    * Create a Node object using a name that was hashed at compile time. If the
+    * database is frozen, this skips hashing the name at runtime.
+    * @param  name Typename of the class you'd like to create.
+    * @return      A pointer to the object, or `nullptr`.
+    */
+   static T* Create(const TypeName& name)
+   {
+      T* retval = nullptr;
+      BaseFactory<T>* factory = Find(name);
+      if (factory)
+      {
+         retval = factory->TakeOrCreate();
+      }
+      return retval;
+   }
+
+   /**
+    * Look up the factory registered for a type name once, so that objects of 
+    * that type can be created later without repeating the lookup. 
+    * @param  name Typename of the class you'd like to create.
+    * @return      A handle to the factory, which will be invalid if nothing
+    *              is registered using that name.
+    */
+   static FactoryHandle<T> Resolve(StringRef name)
+   {
+      return FactoryHandle<T>(Find(name));
+   }
+
+   static FactoryHandle<T> Resolve(const TypeName& name)
+   {
+      return FactoryHandle<T>(Find(name));
+   }
+
+   /**
+    * Create a Node object using a handle returned from `Resolve()`. This 
+    * doesn't touch the database at all.
+    * @param  handle Handle to the factory for the class you'd like to create.
+    * @return        A pointer to the new object, or `nullptr` if the handle
+    *                is invalid.
+    */
+   static T* Create(const FactoryHandle<T>& handle)
+   {
+      T* retval = nullptr;
+      BaseFactory<T>* factory = handle.GetFactory();
       if (factory)
       {
-         retval = factory->Create();
+         retval = factory->TakeOrCreate();
       }
       return retval;
    }
    
    
 protected:
-   static int fCount;
-   static HashMap<String, BaseFactory<T>* >* fDatabase;
+   /**
+    * @class PrewarmJob
+    * @brief Creates objects with a factory and parks them there.
+    */
+   class PrewarmJob : public ThreadPoolJob
+   {
+   public:
+      PrewarmJob(BaseFactory<T>& factory, int count)
+      :  ThreadPoolJob("Prewarm " + factory.GetTypeName())
+      ,  fFactory(factory)
+      ,  fCount(count)
+      {
+
+      }
+
+      JobStatus runJob() override
+      {
+         for (int i = 0; i < fCount && ! shouldExit(); ++i)
+         {
+            fFactory.Park(fFactory.Create());
+         }
+         return jobHasFinished;
+      }
+
+   private:
+      BaseFactory<T>& fFactory;
+      const int fCount;
+   };
+
+   /**
+    * @class CreateJob
+    * @brief Creates (and configures) one object and hands it to a callback.
+    */
+   class CreateJob : public ThreadPoolJob
+   {
+   public:
+      CreateJob(BaseFactory<T>& factory, const ValueTree& config, 
+         CreateCallback callback, AsyncDelivery delivery)
+      :  ThreadPoolJob("Create " + factory.GetTypeName())
+      ,  fFactory(factory)
+      ,  fConfig(config)
+      ,  fCallback(callback)
+      ,  fDelivery(delivery)
+      {
+
+      }
+
+      JobStatus runJob() override
+      {
+         FactoryPtr<T> object = fFactory.CreateUnique();
+         if (object && fConfig.isValid())
+         {
+            object->Configure(fConfig);
+         }
+
+         if (AsyncDelivery::kMessageThread == fDelivery)
+         {
+            // callAsync() needs a copyable function, so the object is shared
+            // until it's delivered. If the message is dropped (at shutdown, 
+            // say) the last copy of the function releases it.
+            const std::shared_ptr<FactoryPtr<T> > shared = 
+               std::make_shared<FactoryPtr<T> >(std::move(object));
+            const CreateCallback callback = fCallback;
+            MessageManager::callAsync([callback, shared] ()
+            {
+               callback(std::move(*shared));
+            });
+         }
+         else
+         {
+            fCallback(std::move(object));
+         }
+         return jobHasFinished;
+      }
+
+   private:
+      BaseFactory<T>& fFactory;
+      const ValueTree fConfig;
+      const CreateCallback fCallback;
+      const AsyncDelivery fDelivery;
+   };
+
+   /**
+    * @class CreateManyJob
+    * @brief Creates (and configures) the objects for a range of a 
+    *        `CreateMany()` list.
+    */
+   class CreateManyJob : public ThreadPoolJob
+   {
+   public:
+      CreateManyJob(const Array<BaseFactory<T>*>& factories, 
+         const Array<ValueTree>& configs, std::vector<FactoryPtr<T> >& objects,
+         int start, int end)
+      :  ThreadPoolJob("CreateMany")
+      ,  fFactories(factories)
+      ,  fConfigs(configs)
+      ,  fObjects(objects)
+      ,  fStart(start)
+      ,  fEnd(end)
+      {
+
+      }
+
+      JobStatus runJob() override
+      {
+         for (int i = fStart; i < fEnd; ++i)
+         {
+            BaseFactory<T>* factory = fFactories.getUnchecked(i);
+            if (nullptr != factory)
+            {
+               // each job only touches its own range of `fObjects`.
+               fObjects[i] = factory->CreateUnique();
+               if (fConfigs.size() > 0 && fObjects[i])
+               {
+                  fObjects[i]->Configure(fConfigs.getReference(i));
+               }
+            }
+         }
+         return jobHasFinished;
+      }
+
+   private:
+      const Array<BaseFactory<T>*>& fFactories;
+      const Array<ValueTree>& fConfigs;
+      std::vector<FactoryPtr<T> >& fObjects;
+      const int fStart;
+      const int fEnd;
+   };
+
+   /**
+    * Look a name up in the database, unless it's already in `resolved`.
+    */
+   static BaseFactory<T>* ResolveOnce(const String& name, 
+      HashMap<String, BaseFactory<T>*>& resolved)
+   {
+      if (resolved.contains(name))
+      {
+         return resolved[name];
+      }
+      BaseFactory<T>* factory = Find(name);
+      resolved.set(name, factory);
+      return factory;
+   }
+
+   /**
+    * Split a list of objects into a few jobs per pool thread, run the last 
+    * job on the calling thread, and wait for the rest.
+    * @param configs Either empty, or a config tree for each factory.
+    */
+   static std::vector<FactoryPtr<T> > CreateMany(const Array<BaseFactory<T>*>& factories, 
+      const Array<ValueTree>& configs, ThreadPool& pool)
+   {
+      // small enough for the jobs to balance out, big enough not to be 
+      // dominated by queueing them.
+      const int kMinPerJob = 256;
+      const int count = factories.size();
+      std::vector<FactoryPtr<T> > retval(static_cast<size_t>(count));
+      const int numJobs = jlimit(1, jmax(1, 4 * (pool.getNumThreads() + 1)), 
+         count / kMinPerJob);
+      const int perJob = (count + numJobs - 1) / numJobs;
+
+      OwnedArray<CreateManyJob> jobs;
+      for (int start = 0; start < count; start += perJob)
+      {
+         jobs.add(new CreateManyJob(factories, configs, retval, start, 
+            jmin(count, start + perJob)));
+      }
+      for (int i = 0; i < jobs.size() - 1; ++i)
+      {
+         pool.addJob(jobs.getUnchecked(i), false);
+      }
+      if (jobs.size() > 0)
+      {
+         jobs.getLast()->runJob();
+      }
+      for (int i = 0; i < jobs.size() - 1; ++i)
+      {
+         pool.waitForJobToFinish(jobs.getUnchecked(i), -1);
+      }
+      return retval;
+   }
+
+   /**
+    * Build a new frozen table and publish it. The caller must hold both the 
+    * write lock and the snapshot writer lock.
+    * @return true if the table was built.
+    */
+   static bool Rebuild()
+   {
+      Storage& storage = GetStorage();
+      FrozenFactoryTable<T>* table = FrozenFactoryTable<T>::Build(storage.database);
+      if (nullptr == table && IsConcurrent())
+      {
+         // readers can't fall back to the HashMap; keep the old table.
+         return false;
+      }
+      storage.frozen.Publish(table);
+      return (nullptr != table);
+   }
+
+   /**
+    * @class ThreadCache
+    * @brief The last few factories that one thread looked up, keyed on the 
+    *        hash of their names.
+    */
+   struct ThreadCache
+   {
+      enum { kNumEntries = 8 };
+
+      struct Entry
+      {
+         uint64 hash;
+         BaseFactory<T>* factory;
+      };
+
+      ThreadCache() noexcept
+      :  fGeneration(0)
+      ,  fNext(0)
+      {
+         Clear();
+      }
+
+      void Clear() noexcept
+      {
+         for (Entry& e : fEntries)
+         {
+            e.hash = 0;
+            e.factory = nullptr;
+         }
+      }
+
+      /**
+       * Look for a factory, first emptying the cache if anything has been 
+       * registered since it was filled.
+       * @return The factory, or nullptr on a miss.
+       */
+      BaseFactory<T>* Find(uint32 generation, uint64 hash, StringRef name) noexcept
+      {
+         if (generation != fGeneration)
+         {
+            Clear();
+            fGeneration = generation;
+            return nullptr;
+         }
+         for (const Entry& e : fEntries)
+         {
+            // the name check guards against two names with the same hash.
+            if (hash == e.hash && nullptr != e.factory && e.factory->GetTypeName() == name)
+            {
+               return e.factory;
+            }
+         }
+         return nullptr;
+      }
+
+      void Add(uint64 hash, BaseFactory<T>* factory) noexcept
+      {
+         Entry& e = fEntries[fNext];
+         e.hash = hash;
+         e.factory = factory;
+         fNext = (fNext + 1) % kNumEntries;
+      }
+
+      Entry fEntries[kNumEntries];
+      uint32 fGeneration;
+      int fNext;
+   };
+
+   static ThreadCache& GetThreadCache() noexcept
+   {
+      static thread_local ThreadCache cache;
+      return cache;
+   }
+
+   /**
+    * Look a factory up in this thread's cache, and fall back to the records
+    * and the shared database on a miss. Recorded factories never change and
+    * a recorded name can't be registered, so whichever of them the factory 
+    * came from, it's valid to cache until the next registration.
+    */
+   template <class Name>
+   static BaseFactory<T>* FindCached(const Name& name, StringRef nameString, uint64 hash)
+   {
+      // read the generation before the lookup so that a registration that 
+      // races with us can only make the new entry look stale, not fresh.
+      const uint32 generation = fGeneration.load(std::memory_order_acquire);
+      ThreadCache& cache = GetThreadCache();
+      BaseFactory<T>* factory = cache.Find(generation, hash, nameString);
+      if (nullptr == factory)
+      {
+         factory = FindUncached(name, hash);
+         if (nullptr != factory)
+         {
+            cache.Add(hash, factory);
+         }
+      }
+      return factory;
+   }
+
+   /**
+    * The name is hashed once, and the hash is shared by the thread cache, 
+    * the record index and the frozen table. A thread cache hit comes first;
+    * after that, in a hierarchy with FactoryRecords, the record index is 
+    * checked before the factories registered at run time (recorded 
+    * factories are never anywhere else, so a recorded name can't be 
+    * replaced by registering a factory with the same name).
+    */
+   static BaseFactory<T>* Find(StringRef name)
+   {
+      const uint64 hash = TypeNameHash::Calculate(name);
+      if (IsThreadCacheEnabled())
+      {
+         return FindCached(name, name, hash);
+      }
+      return FindUncached(name, hash);
+   }
+
+   static BaseFactory<T>* Find(const TypeName& name)
+   {
+      if (IsThreadCacheEnabled())
+      {
+         return FindCached(name, name, name.GetHash());
+      }
+      return FindUncached(name, name.GetHash());
+   }
+
+   /**
+    * Look in the records, then among the registered factories.
+    */
+   template <class Name>
+   static BaseFactory<T>* FindUncached(const Name& name, uint64 hash)
+   {
+      if (fRecordsBegin != fRecordsEnd)
+      {
+         if (BaseFactory<T>* recorded = FindRecorded(name, hash))
+         {
+            return recorded;
+         }
+      }
+      return FindShared(name, hash);
+   }
+
+   /**
+    * Look for a name among the hierarchy's FactoryRecords, creating its 
+    * factory if it's the first time it's been used. The index is read-only 
+    * once it's built and recorded factories aren't registered, so this 
+    * needs no locks even when several threads use the same record for the 
+    * first time at once.
+    */
+   static BaseFactory<T>* FindRecorded(StringRef name, uint64 hash)
+   {
+      const FactoryRecord<T>* record = GetRecordIndex().Find(
+         name.text.getAddress(), name.text.sizeInBytes() - 1, hash);
+      return (nullptr != record) ? record->getFactory(*record) : nullptr;
+   }
+
+   /**
+    * @return The index of the hierarchy's records, sorted the first time 
+    *         it's needed and never changed after that.
+    */
+   static const FactoryRecordIndex<T>& GetRecordIndex()
+   {
+      static const FactoryRecordIndex<T> index(fRecordsBegin, fRecordsEnd);
+      // a name recorded twice, or two names whose hashes collide (which 
+      // TypeName::AreDistinct() can only catch for names it's given).
+      jassert(index.HasDistinctHashes());
+      return index;
+   }
+
+   static BaseFactory<T>* FindShared(StringRef name, uint64 hash)
+   {
+      Storage& storage = GetStorage();
+      if (IsConcurrent())
+      {
+         const typename FrozenSnapshots::ReadGuard table(storage.frozen);
+         return table->Find(name, hash);
+      }
+      const ScopedReadLock rl(storage.lock);
+      if (const FrozenFactoryTable<T>* table = storage.frozen.GetUnprotected())
+      {
+         return table->Find(name, hash);
+      }
+      return storage.database[name];
+   }
+
+   static BaseFactory<T>* FindShared(const TypeName& name, uint64 /*hash*/)
+   {
+      Storage& storage = GetStorage();
+      if (IsConcurrent())
+      {
+         const typename FrozenSnapshots::ReadGuard table(storage.frozen);
+         return table->Find(name);
+      }
+      const ScopedReadLock rl(storage.lock);
+      if (const FrozenFactoryTable<T>* table = storage.frozen.GetUnprotected())
+      {
+         return table->Find(name);
+      }
+      return storage.database[String(CharPointer_UTF8(name.GetName()), name.GetLength())];
+   }
+
+   /**
+    * @struct Storage
+    * @brief The parts of the database that need constructing.
+    */
+   struct Storage
+   {
+      Map database;
+      FrozenSnapshots frozen;
+      LockType lock;
+   };
+
+   /**
+    * @return The database's storage, created the first time it's needed 
+    *         (which may be during static initialization, from a Factory's 
+    *         constructor in any file).
+    */
+   static Storage& GetStorage()
+   {
+      static Storage storage;
+      return storage;
+   }
+
+   static std::atomic<bool> fConcurrent;
+   static std::atomic<uint32> fGeneration;
+   static std::atomic<bool> fThreadCacheEnabled;
+   /// the hierarchy's FactoryRecords, or nullptr if it doesn't use them.
+   static const FactoryRecord<T>* const fRecordsBegin;
+   static const FactoryRecord<T>* const fRecordsEnd;
 };
 
 
+/**
+ * Define the static data members of a FactoryDatabase specialization. Use 
+ * this once, in a cpp file, for each class hierarchy.
+ */
+#define FACTORY_DATABASE_STORAGE(DatabaseType) \
+   FACTORY_DATABASE_STORAGE_COMMON(DatabaseType) \
+   template<> const FactoryRecord<DatabaseType::Node>* const DatabaseType::fRecordsBegin = nullptr; \
+   template<> const FactoryRecord<DatabaseType::Node>* const DatabaseType::fRecordsEnd = nullptr;
+
+#if FACTORY_RECORDS_SUPPORTED
+/**
+ * Use this instead of `FACTORY_DATABASE_STORAGE()` for a class hierarchy 
+ * whose types are registered with `FACTORY_RECORD()`, passing the same 
+ * section name.
+ */
+#define FACTORY_DATABASE_STORAGE_WITH_RECORDS(DatabaseType, Section) \
+   FACTORY_RECORD_SECTION_BOUNDS(DatabaseType::Node, Section) \
+   FACTORY_DATABASE_STORAGE_COMMON(DatabaseType) \
+   template<> const FactoryRecord<DatabaseType::Node>* const DatabaseType::fRecordsBegin = \
+      FACTORY_RECORD_SECTION_BEGIN(Section); \
+   template<> const FactoryRecord<DatabaseType::Node>* const DatabaseType::fRecordsEnd = \
+      FACTORY_RECORD_SECTION_END(Section);
+#else
+#define FACTORY_DATABASE_STORAGE_WITH_RECORDS(DatabaseType, Section) \
+   FACTORY_DATABASE_STORAGE(DatabaseType)
+#endif
+
+#define FACTORY_DATABASE_STORAGE_COMMON(DatabaseType) \
+   template<> std::atomic<bool> DatabaseType::fConcurrent(false); \
+   template<> std::atomic<uint32> DatabaseType::fGeneration(0); \
+   template<> std::atomic<bool> DatabaseType::fThreadCacheEnabled(false);
+
+
 
 #endif  // FACTORYDATABASE_H_INCLUDED
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2016 Brett g Porter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above
+ * copyright notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS",
+ * WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FACTORYLOCKS_H_INCLUDED
+#define FACTORYLOCKS_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+#include <atomic>
+
+/**
+ * @file
+ * Locking policies for FactoryDatabase. 
+ *
+ * A class hierarchy picks its policy with the second template argument of 
+ * FactoryBuildable:
+ * ```
+ * class Base : public FactoryBuildable<Base, ReaderOptimisedLock>
+ * ```
+ * and any of these can be used:
+ *
+ * - `DummyCriticalSection` (the default): no locking at all. Fastest, but only 
+ *   safe if nothing is registered once other threads start creating objects.
+ * - `SpinLock` or `CriticalSection`: one lock around every registration and
+ *   lookup. Simple, but lookups on different threads serialise.
+ * - `ReadWriteLock`: lookups share the lock, registrations are exclusive. 
+ *   Every lookup still writes to the lock's shared state, though.
+ * - `ReaderOptimisedLock` (below): lookups only write to a per-thread 
+ *   counter, so they scale with the number of threads, at the cost of 
+ *   making registration slower.
+ *
+ * (FactoryDatabase::EnableConcurrentAccess() is a further step up from these:
+ * lookups there don't take any lock at all.)
+ *
+ * The database takes the lock itself rather than handing it to its HashMap, 
+ * so that the read/write distinction can be used, and so that a frozen table
+ * is covered by the same lock as the HashMap.
+ */
+
+
+/**
+ * @class ReaderOptimisedLock
+ * @brief A reader/writer lock where readers don't share any cache lines with
+ *        each other.
+ *
+ * Each reader increments a counter in one of a fixed set of slots (handed out
+ * to threads round robin, each on its own cache line) and then checks that 
+ * no writer is active. A writer raises its flag and then waits for every
+ * slot's counter to drain. Readers therefore never contend with each other, 
+ * and the lock is meant for data like the factory database that is read 
+ * constantly and written hardly ever.
+ *
+ * Neither reads nor writes are re-entrant.
+ */
+class ReaderOptimisedLock
+{
+public:
+   ReaderOptimisedLock() noexcept
+   :  fWriting(false)
+   {
+      for (ReaderCount& r : fReaders)
+      {
+         r.count.store(0);
+      }
+   }
+
+   void EnterRead() const noexcept
+   {
+      std::atomic<int>& count = fReaders[ReaderSlot()].count;
+      for (;;)
+      {
+         count.fetch_add(1);
+         if (! fWriting.load())
+         {
+            return;
+         }
+         // a writer's active (or about to be) -- get out of its way.
+         count.fetch_sub(1);
+         while (fWriting.load())
+         {
+            Thread::yield();
+         }
+      }
+   }
+
+   void ExitRead() const noexcept
+   {
+      fReaders[ReaderSlot()].count.fetch_sub(1, std::memory_order_release);
+   }
+
+   void EnterWrite() const noexcept
+   {
+      fWriterLock.enter();
+      fWriting.store(true);
+      for (const ReaderCount& r : fReaders)
+      {
+         while (0 != r.count.load())
+         {
+            Thread::yield();
+         }
+      }
+   }
+
+   void ExitWrite() const noexcept
+   {
+      fWriting.store(false);
+      fWriterLock.exit();
+   }
+
+   class ScopedReadLock
+   {
+   public:
+      explicit ScopedReadLock(const ReaderOptimisedLock& lock) noexcept
+      :  fLock(lock)
+      {
+         fLock.EnterRead();
+      }
+
+      ~ScopedReadLock() noexcept
+      {
+         fLock.ExitRead();
+      }
+
+   private:
+      const ReaderOptimisedLock& fLock;
+      JUCE_DECLARE_NON_COPYABLE(ScopedReadLock)
+   };
+
+   class ScopedWriteLock
+   {
+   public:
+      explicit ScopedWriteLock(const ReaderOptimisedLock& lock) noexcept
+      :  fLock(lock)
+      {
+         fLock.EnterWrite();
+      }
+
+      ~ScopedWriteLock() noexcept
+      {
+         fLock.ExitWrite();
+      }
+
+   private:
+      const ReaderOptimisedLock& fLock;
+      JUCE_DECLARE_NON_COPYABLE(ScopedWriteLock)
+   };
+
+private:
+   enum 
+   { 
+      kNumReaderSlots = 64,
+      kCacheLineSize = 64
+   };
+
+   struct ReaderCount
+   {
+      std::atomic<int> count;
+      char padding[kCacheLineSize - sizeof(std::atomic<int>)];
+   };
+
+   static int ReaderSlot() noexcept
+   {
+      static std::atomic<int> nextSlot(0);
+      static thread_local const int slot = nextSlot.fetch_add(1) % kNumReaderSlots;
+      return slot;
+   }
+
+   mutable ReaderCount fReaders[kNumReaderSlots];
+   mutable std::atomic<bool> fWriting;
+   CriticalSection fWriterLock;
+
+   JUCE_DECLARE_NON_COPYABLE(ReaderOptimisedLock)
+};
+
+
+/**
+ * @class FactoryLockTraits
+ * @brief Maps a lock type onto the scoped read and write lock types that 
+ *        FactoryDatabase uses with it. 
+ *
+ * Exclusive locks (anything with a `ScopedLockType`, like the JUCE 
+ * CriticalSection, SpinLock and DummyCriticalSection) use the same scoped 
+ * lock for both.
+ */
+template <class LockType>
+struct FactoryLockTraits
+{
+   typedef typename LockType::ScopedLockType ScopedReadLock;
+   typedef typename LockType::ScopedLockType ScopedWriteLock;
+};
+
+template <>
+struct FactoryLockTraits<ReadWriteLock>
+{
+   typedef juce::ScopedReadLock ScopedReadLock;
+   typedef juce::ScopedWriteLock ScopedWriteLock;
+};
+
+template <>
+struct FactoryLockTraits<ReaderOptimisedLock>
+{
+   typedef ReaderOptimisedLock::ScopedReadLock ScopedReadLock;
+   typedef ReaderOptimisedLock::ScopedWriteLock ScopedWriteLock;
+};
+
+
+#endif  // FACTORYLOCKS_H_INCLUDED
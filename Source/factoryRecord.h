@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2016 Brett g Porter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above
+ * copyright notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS",
+ * WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FACTORYRECORD_H_INCLUDED
+#define FACTORYRECORD_H_INCLUDED
+
+#include "factory.h"
+#include "typeName.h"
+
+#include <algorithm>
+
+/**
+ * @struct FactoryRecord
+ *
+ * @brief A registration that's laid down by the compiler and linker instead 
+ *        of being made by code that runs during static initialization.
+ *
+ * Declaring a `Factory` object at file scope registers the type while the 
+ * program (or a library being `dlopen`ed) starts up: the factory's 
+ * constructor builds a String, adds it to the database's HashMap, and logs
+ * it. With thousands of types that adds up. A record is plain constant 
+ * data instead -- the type's name, the name's hash, and a function that 
+ * returns its factory -- so there's nothing to run at startup at all:
+ * ```
+ * FACTORY_RECORD(cf_base, Base, Smaller, BaseTypes::kSmaller);
+ * ```
+ * The linker gathers every record for a class hierarchy into one section, 
+ * which that hierarchy's database is told about with 
+ * `FACTORY_DATABASE_STORAGE_WITH_RECORDS()`. Lookups check the records 
+ * (through a FactoryRecordIndex that's built the first time it's needed) 
+ * before the factories registered at run time; only a hit in a thread's 
+ * lookup cache comes first. The first time a record is used its factory is
+ * created. Recorded factories are never added to the database's HashMap -- 
+ * they're always found through their records -- so using a record for the 
+ * first time doesn't write to anything that other threads are reading.
+ *
+ * Records need ELF (Linux) or Mach-O (macOS) linker sections; elsewhere 
+ * `FACTORY_RECORD()` falls back to declaring an ordinary Factory.
+ */
+template <class T>
+struct FactoryRecord
+{
+   const char* name;
+   size_t length;
+   uint64 hash;
+   /// creates the factory the first time it's called, and returns it.
+   BaseFactory<T>* (*getFactory)(const FactoryRecord& record);
+};
+
+
+/**
+ * @class FactoryRecordIndex
+ *
+ * @brief A read-only index of a table of FactoryRecords, for finding 
+ *        records by name in constant time.
+ *
+ * The records themselves stay where the linker put them and aren't 
+ * copied. (They hold pointers, so in a position-independent program the 
+ * loader still has to relocate them at startup; they aren't read-only 
+ * shared pages.) The index is built once: a compact array of 
+ * (hash, record) pairs sorted by hash, plus a directory that maps the top 
+ * bits of a hash to the first pair with those bits. A lookup reads one 
+ * directory slot and then, on average, about one pair before it compares 
+ * a name.
+ */
+template <class T>
+class FactoryRecordIndex
+{
+public:
+   FactoryRecordIndex(const FactoryRecord<T>* begin, const FactoryRecord<T>* end)
+   :  fNumEntries(static_cast<int>(end - begin))
+   ,  fNumCollisions(0)
+   ,  fShift(63)
+   {
+      fEntries.malloc(jmax(1, fNumEntries));
+      for (int i = 0; i < fNumEntries; ++i)
+      {
+         fEntries[i].hash = begin[i].hash;
+         fEntries[i].record = begin + i;
+      }
+      std::sort(fEntries.getData(), fEntries.getData() + fNumEntries, 
+         [] (const Entry& a, const Entry& b) { return a.hash < b.hash; });
+
+      // equal hashes are next to each other now. Lookups still work (they 
+      // compare names), but a frozen table can't hold both names.
+      for (int i = 1; i < fNumEntries; ++i)
+      {
+         if (fEntries[i - 1].hash == fEntries[i].hash)
+         {
+            DBG("Type names with the same hash: " 
+               << String(CharPointer_UTF8(fEntries[i - 1].record->name), fEntries[i - 1].record->length) 
+               << ", " << String(CharPointer_UTF8(fEntries[i].record->name), fEntries[i].record->length));
+            ++fNumCollisions;
+         }
+      }
+
+      // one directory slot per record (rounded up to a power of 2), 
+      // selected by the top bits of the hash.
+      int numSlots = 2;
+      while (numSlots < fNumEntries)
+      {
+         numSlots *= 2;
+         --fShift;
+      }
+      fDirectory.malloc(numSlots + 1);
+      int entry = 0;
+      for (int slot = 0; slot <= numSlots; ++slot)
+      {
+         while (entry < fNumEntries && SlotOf(fEntries[entry].hash) < slot)
+         {
+            ++entry;
+         }
+         fDirectory[slot] = entry;
+      }
+   }
+
+   /**
+    * @return The record with this name, or nullptr.
+    */
+   const FactoryRecord<T>* Find(const char* name, size_t length, uint64 hash) const noexcept
+   {
+      const int slot = SlotOf(hash);
+      for (int i = fDirectory[slot]; i < fDirectory[slot + 1]; ++i)
+      {
+         const Entry& entry = fEntries[i];
+         if (entry.hash == hash && entry.record->length == length 
+            && 0 == memcmp(entry.record->name, name, length))
+         {
+            return entry.record;
+         }
+      }
+      return nullptr;
+   }
+
+   int size() const noexcept
+   {
+      return fNumEntries;
+   }
+
+   /**
+    * @return false if any two records have the same hash, either because a 
+    *         name was recorded twice or because two names collide.
+    */
+   bool HasDistinctHashes() const noexcept
+   {
+      return (0 == fNumCollisions);
+   }
+
+private:
+   int SlotOf(uint64 hash) const noexcept
+   {
+      return static_cast<int>(hash >> fShift);
+   }
+
+   struct Entry
+   {
+      uint64 hash;
+      const FactoryRecord<T>* record;
+   };
+
+   HeapBlock<Entry> fEntries;
+   const int fNumEntries;
+   int fNumCollisions;
+   /// fDirectory[slot] is the first entry whose hash falls in `slot`.
+   HeapBlock<int> fDirectory;
+   int fShift;
+
+   JUCE_DECLARE_NON_COPYABLE(FactoryRecordIndex)
+};
+
+
+/**
+ * The factory for a record, created the first time that it's needed (which 
+ * is thread safe, like any function-local static) and never registered. 
+ * `Tag` is unique to each record so that a class registered under more 
+ * than one name gets a factory for each of them.
+ */
+template <class T, class FactoryType, class Tag>
+BaseFactory<T>* GetRecordedFactory(const FactoryRecord<T>& record)
+{
+   static FactoryType factory(String(CharPointer_UTF8(record.name), record.length),
+      UnregisteredFactory());
+   return &factory;
+}
+
+
+#if defined(__ELF__) || defined(__APPLE__)
+  #define FACTORY_RECORDS_SUPPORTED 1
+#else
+  #define FACTORY_RECORDS_SUPPORTED 0
+#endif
+
+#if defined(__APPLE__)
+  #define FACTORY_RECORD_SECTION_ATTRIBUTE(Section) \
+     __attribute__((used, section("__DATA," #Section)))
+  #define FACTORY_RECORD_SECTION_BOUNDS(BaseType, Section) \
+     extern const FactoryRecord<BaseType> Section##_start[] \
+        __asm("section$start$__DATA$" #Section); \
+     extern const FactoryRecord<BaseType> Section##_stop[] \
+        __asm("section$end$__DATA$" #Section);
+  #define FACTORY_RECORD_SECTION_BEGIN(Section) Section##_start
+  #define FACTORY_RECORD_SECTION_END(Section) Section##_stop
+#elif defined(__ELF__)
+  #define FACTORY_RECORD_SECTION_ATTRIBUTE(Section) \
+     __attribute__((used, section(#Section)))
+  // the linker defines __start_/__stop_ symbols for any section whose name 
+  // is a C identifier; they're weak so that an empty section is fine.
+  #define FACTORY_RECORD_SECTION_BOUNDS(BaseType, Section) \
+     extern "C" const FactoryRecord<BaseType> __start_##Section[] __attribute__((weak)); \
+     extern "C" const FactoryRecord<BaseType> __stop_##Section[] __attribute__((weak));
+  #define FACTORY_RECORD_SECTION_BEGIN(Section) __start_##Section
+  #define FACTORY_RECORD_SECTION_END(Section) __stop_##Section
+#endif
+
+
+#if FACTORY_RECORDS_SUPPORTED
+/**
+ * Register `DerivedType` with the database for `BaseType` using a record 
+ * in the linker section `Section`, a C identifier shared by the whole class
+ * hierarchy. `typeName` is a constant TypeName (e.g. `"smaller"_type`). Use
+ * this at file scope in a cpp file.
+ */
+#define FACTORY_RECORD(Section, BaseType, DerivedType, typeName) \
+   FACTORY_RECORD_WITH_FACTORY(Section, BaseType, typeName, \
+      Factory<BaseType, DerivedType>)
+
+/**
+ * Like `FACTORY_RECORD()`, but with some other kind of factory (e.g. a 
+ * PooledFactory, or a Factory that takes arguments), which must have a 
+ * constructor that takes an UnregisteredFactory. The factory type comes 
+ * last so that its template arguments can contain commas.
+ */
+#define FACTORY_RECORD_WITH_FACTORY(Section, BaseType, typeName, ...) \
+   FACTORY_RECORD_WITH_ID(__COUNTER__, Section, BaseType, typeName, __VA_ARGS__)
+
+// `Id` makes the names that a record declares unique, even when a macro 
+// declares several records on one line.
+#define FACTORY_RECORD_WITH_ID(Id, Section, BaseType, typeName, ...) \
+   namespace { struct JUCE_JOIN_MACRO(FactoryRecordTag, Id) {}; } \
+   FACTORY_RECORD_SECTION_ATTRIBUTE(Section) \
+   static constexpr FactoryRecord<BaseType> JUCE_JOIN_MACRO(factoryRecord, Id) = \
+   { \
+      (typeName).GetName(), (typeName).GetLength(), (typeName).GetHash(), \
+      &GetRecordedFactory<BaseType, __VA_ARGS__, JUCE_JOIN_MACRO(FactoryRecordTag, Id)> \
+   }
+#else
+#define FACTORY_RECORD(Section, BaseType, DerivedType, typeName) \
+   static Factory<BaseType, DerivedType> JUCE_JOIN_MACRO(recordedFactory, __COUNTER__)(typeName)
+
+#define FACTORY_RECORD_WITH_FACTORY(Section, BaseType, typeName, ...) \
+   static __VA_ARGS__ JUCE_JOIN_MACRO(recordedFactory, __COUNTER__)(typeName)
+#endif
+
+
+#endif  // FACTORYRECORD_H_INCLUDED
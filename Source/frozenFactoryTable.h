@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2016 Brett g Porter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above
+ * copyright notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS",
+ * WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FROZENFACTORYTABLE_H_INCLUDED
+#define FROZENFACTORYTABLE_H_INCLUDED
+
+#include "factory.h"
+#include "typeName.h"
+
+#include <vector>
+
+/**
+ * @class FrozenFactoryTable
+ *
+ * @brief A read-only snapshot of a factory database, laid out for fast lookups.
+ *
+ * Once all of the factories for a class hierarchy have registered themselves
+ * the set of names usually never changes again. At that point we can trade 
+ * the general purpose HashMap (chained buckets, a modulo per lookup, and a 
+ * temporary String built from the name) for a minimal perfect hash:
+ *
+ * - every name is hashed once (64-bit FNV-1a, see typeName.h).
+ * - the mixed hash picks one of a small number of buckets. Each bucket has a
+ *   32-bit 'displacement' value that was chosen when the table was built so 
+ *   that every name lands in its own slot. With n names there are exactly 
+ *   n slots, so there are no empty slots and no probing.
+ * - each slot is exactly one cache line holding the full hash, the factory 
+ *   pointer, and (for names up to 43 bytes long) the name itself, so a 
+ *   successful lookup only needs to touch that one line of the slot array
+ *   (the displacement array is tiny and stays hot in cache).
+ *
+ * This is the 'hash and displace' construction from Belazzougui, Botelho &
+ * Dietzfelbinger, with multiply-shift range reduction instead of `%`.
+ *
+ * Tables are built by FactoryDatabase::Freeze() and never modified -- a 
+ * change to the database builds a new table.
+ */
+template <class T>
+class FrozenFactoryTable
+{
+public:
+   /**
+    * Build a table holding all of the entries currently in `database`.
+    * @param  database map of type names to factories.
+    * @return          a new table (owned by the caller), or nullptr if the 
+    *                  table couldn't be built. That only happens if two names
+    *                  have identical 64-bit hashes.
+    */
+   static FrozenFactoryTable* Build(const HashMap<String, BaseFactory<T>* >& database)
+   {
+      ScopedPointer<FrozenFactoryTable> table = new FrozenFactoryTable();
+      if (! table->Fill(database))
+      {
+         jassertfalse;
+         table = nullptr;
+      }
+      return table.release();
+   }
+
+   /**
+    * Find the factory that's registered with a given name.
+    * @param  name type name to look up.
+    * @return      the factory, or nullptr if the name isn't in the table.
+    */
+   BaseFactory<T>* Find(StringRef name) const noexcept
+   {
+      size_t length;
+      const uint64 hash = TypeNameHash::Calculate(name, &length);
+      return Find(name.text.getAddress(), length, hash);
+   }
+
+   /**
+    * Find a factory using a hash of its name that's already been calculated 
+    * with `TypeNameHash::Calculate()`.
+    */
+   BaseFactory<T>* Find(StringRef name, uint64 hash) const noexcept
+   {
+      return Find(name.text.getAddress(), name.text.sizeInBytes() - 1, hash);
+   }
+
+   /**
+    * Find a factory using a name that was hashed at compile time.
+    */
+   BaseFactory<T>* Find(const TypeName& name) const noexcept
+   {
+      return Find(name.GetName(), name.GetLength(), name.GetHash());
+   }
+
+   /**
+    * @return the number of names in the table.
+    */
+   int GetNumEntries() const noexcept
+   {
+      return static_cast<int>(fNumSlots);
+   }
+
+private:
+   enum
+   {
+      kCacheLineSize = 64,
+      /// buckets are sized so that they hold this many names on average. 
+      kNamesPerBucket = 2,
+      /// number of displacement values we try for a bucket before starting
+      /// again with a new seed.
+      kMaxDisplacementTries = 1 << 16
+   };
+
+   struct Slot
+   {
+      uint64 hash;
+      BaseFactory<T>* factory;
+      uint32 length;
+      /// The type name, NUL-terminated, if it fits.
+      char name[kCacheLineSize - sizeof(uint64) - sizeof(void*) - sizeof(uint32)];
+   };
+
+   static_assert(sizeof(Slot) == kCacheLineSize, "table slots must fill a cache line");
+
+   struct Entry
+   {
+      String name;
+      uint64 hash;
+      uint64 mixed;
+      BaseFactory<T>* factory;
+   };
+
+   FrozenFactoryTable()
+   :  fNumSlots(0)
+   ,  fNumBuckets(0)
+   ,  fSeed(0)
+   ,  fSlots(nullptr)
+   {
+
+   }
+
+   BaseFactory<T>* Find(const char* name, size_t length, uint64 hash) const noexcept
+   {
+      if (0 == fNumSlots)
+      {
+         return nullptr;
+      }
+
+      const Slot& slot = fSlots[SlotIndex(hash)];
+      if (slot.hash != hash || slot.length != length)
+      {
+         return nullptr;
+      }
+      if (length < sizeof(slot.name))
+      {
+         return (0 == std::memcmp(slot.name, name, length)) ? slot.factory : nullptr;
+      }
+      // name too long to be stored inline -- check against the factory.
+      return (slot.factory->GetTypeName() == StringRef(name)) ? slot.factory : nullptr;
+   }
+
+   uint32 SlotIndex(uint64 hash) const noexcept
+   {
+      const uint64 mixed = TypeNameHash::Mix(hash ^ fSeed);
+      const uint32 bucket = TypeNameHash::Reduce(static_cast<uint32>(mixed), fNumBuckets);
+      return TypeNameHash::Reduce(static_cast<uint32>(mixed >> 32) ^ fDisplacements[bucket], 
+         fNumSlots);
+   }
+
+   bool Fill(const HashMap<String, BaseFactory<T>* >& database)
+   {
+      // a std::vector because Entry holds a String, and juce::Array moves 
+      // its elements with realloc().
+      std::vector<Entry> entries;
+      for (typename HashMap<String, BaseFactory<T>* >::Iterator i(database); i.next();)
+      {
+         Entry e;
+         e.name = i.getKey();
+         e.hash = TypeNameHash::Calculate(e.name.toRawUTF8());
+         e.mixed = 0;
+         e.factory = i.getValue();
+         if (nullptr != e.factory)
+         {
+            entries.push_back(e);
+         }
+      }
+
+      fNumSlots = static_cast<uint32>(entries.size());
+      if (0 == fNumSlots)
+      {
+         return true;
+      }
+      fNumBuckets = jmax(1u, fNumSlots / kNamesPerBucket);
+
+      // the 64 byte slots are aligned on cache line boundaries.
+      fSlotStorage.calloc((fNumSlots + 1) * sizeof(Slot));
+      fSlots = reinterpret_cast<Slot*>((reinterpret_cast<pointer_sized_uint>(fSlotStorage.getData()) 
+         + kCacheLineSize - 1) & ~static_cast<pointer_sized_uint>(kCacheLineSize - 1));
+      fDisplacements.calloc(fNumBuckets);
+
+      for (uint64 seed = 0; seed < 64; ++seed)
+      {
+         fSeed = TypeNameHash::Mix(seed + 1);
+         if (PlaceEntries(entries))
+         {
+            return true;
+         }
+      }
+      return false;
+   }
+
+   /**
+    * Try to find displacement values that give every entry its own slot 
+    * using the current seed.
+    */
+   bool PlaceEntries(std::vector<Entry>& entries)
+   {
+      std::vector<std::vector<int> > buckets(fNumBuckets);
+      for (size_t i = 0; i < entries.size(); ++i)
+      {
+         Entry& e = entries[i];
+         e.mixed = TypeNameHash::Mix(e.hash ^ fSeed);
+         buckets[TypeNameHash::Reduce(static_cast<uint32>(e.mixed), fNumBuckets)].push_back(
+            static_cast<int>(i));
+      }
+
+      // place the most crowded buckets first while there's the most room.
+      Array<int> order;
+      for (int b = 0; b < static_cast<int>(buckets.size()); ++b)
+      {
+         order.add(b);
+      }
+      std::stable_sort(order.begin(), order.end(), [&buckets] (int a, int b)
+      {
+         return buckets[a].size() > buckets[b].size();
+      });
+
+      HeapBlock<bool> taken(fNumSlots, true);
+      Array<uint32> placed;
+      for (int b : order)
+      {
+         const std::vector<int>& members = buckets[b];
+         if (members.empty())
+         {
+            break;
+         }
+         bool found = false;
+         for (uint32 attempt = 0; attempt < kMaxDisplacementTries && ! found; ++attempt)
+         {
+            const uint32 displacement = static_cast<uint32>(TypeNameHash::Mix(attempt));
+            placed.clearQuick();
+            found = true;
+            for (int i : members)
+            {
+               const uint32 slot = TypeNameHash::Reduce(
+                  static_cast<uint32>(entries[i].mixed >> 32) ^ displacement, fNumSlots);
+               if (taken[slot] || placed.contains(slot))
+               {
+                  found = false;
+                  break;
+               }
+               placed.add(slot);
+            }
+            if (found)
+            {
+               fDisplacements[b] = displacement;
+               for (uint32 slot : placed)
+               {
+                  taken[slot] = true;
+               }
+            }
+         }
+         if (! found)
+         {
+            return false;
+         }
+      }
+
+      for (const Entry& e : entries)
+      {
+         Slot& slot = fSlots[SlotIndex(e.hash)];
+         slot.hash = e.hash;
+         slot.factory = e.factory;
+         slot.length = static_cast<uint32>(e.name.getNumBytesAsUTF8());
+         if (slot.length < sizeof(slot.name))
+         {
+            std::memcpy(slot.name, e.name.toRawUTF8(), slot.length + 1);
+         }
+      }
+      return true;
+   }
+
+   uint32 fNumSlots;
+   uint32 fNumBuckets;
+   uint64 fSeed;
+   HeapBlock<uint32> fDisplacements;
+   HeapBlock<char> fSlotStorage;
+   Slot* fSlots;
+
+   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FrozenFactoryTable)
+};
+
+
+#endif  // FROZENFACTORYTABLE_H_INCLUDED
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2016 Brett g Porter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above
+ * copyright notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS",
+ * WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef OBJECTARENA_H_INCLUDED
+#define OBJECTARENA_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+#include <new>
+
+/**
+ * @class ObjectArena
+ *
+ * @brief A region of memory that objects are bump-allocated from, and that 
+ *        destroys all of them at once when it's reset.
+ *
+ * Use an arena when you're going to build a lot of objects, use them for a 
+ * while (handling one request, say), and then throw all of them away:
+ * ```
+ * ObjectArena arena;
+ * Base* b = Base::Create("smaller", arena);
+ * ...
+ * arena.Reset();    // destroys b and everything else created in the arena
+ * ```
+ * Objects in an arena belong to it and must **not** be deleted. `Reset()` 
+ * runs their destructors in the reverse of the order that they were created 
+ * in, and then makes all of the arena's memory available to be used again; 
+ * the memory itself is only freed when the arena is destroyed.
+ *
+ * An arena isn't thread safe; give each thread its own.
+ */
+class ObjectArena
+{
+public:
+   /**
+    * @param blockSize Number of bytes to allocate from the system at a time.
+    *                  Objects too big for one block get a block of their own.
+    */
+   explicit ObjectArena(size_t blockSize = 16384)
+   :  fBlockSize(blockSize)
+   ,  fCurrentBlock(-1)
+   ,  fNext(nullptr)
+   ,  fEnd(nullptr)
+   ,  fLast(nullptr)
+   ,  fNumObjects(0)
+   {
+
+   }
+
+   ~ObjectArena()
+   {
+      Reset();
+      for (const Block& b : fBlocks)
+      {
+         std::free(b.data);
+      }
+   }
+
+   /**
+    * Construct an object of type `U` inside the arena.
+    * @param  args Arguments for `U`'s constructor.
+    * @return      The new object, which is owned by the arena.
+    */
+   template <class U, class... Args>
+   U* Construct(Args&&... args)
+   {
+      void* memory = Allocate(sizeof(U), alignof(U));
+      U* retval = new (memory) U(std::forward<Args>(args)...);
+      // only record the object once it's been successfully constructed.
+      Header* header = static_cast<Header*>(memory) - 1;
+      header->destroy = &Destroy<U>;
+      header->previous = fLast;
+      fLast = header;
+      ++fNumObjects;
+      return retval;
+   }
+
+   /**
+    * Destroy every object in the arena, newest first, and rewind to the start
+    * of its memory.
+    */
+   void Reset() noexcept
+   {
+      while (nullptr != fLast)
+      {
+         Header* header = fLast;
+         fLast = header->previous;
+         header->destroy(header + 1);
+      }
+      fNumObjects = 0;
+      fCurrentBlock = -1;
+      fNext = nullptr;
+      fEnd = nullptr;
+   }
+
+   /**
+    * @return The number of objects currently in the arena.
+    */
+   int GetNumObjects() const noexcept
+   {
+      return fNumObjects;
+   }
+
+   /**
+    * @return The number of bytes allocated from the system.
+    */
+   size_t GetCapacity() const noexcept
+   {
+      size_t retval = 0;
+      for (const Block& b : fBlocks)
+      {
+         retval += b.size;
+      }
+      return retval;
+   }
+
+private:
+   /// Stored immediately before each object, making a list of the objects 
+   /// in the arena from newest to oldest.
+   struct Header
+   {
+      void (*destroy)(void*);
+      Header* previous;
+   };
+
+   struct Block
+   {
+      char* data;
+      size_t size;
+   };
+
+   template <class U>
+   static void Destroy(void* object) noexcept
+   {
+      static_cast<U*>(object)->~U();
+   }
+
+   /**
+    * Find room for an object and a Header in front of it.
+    * @return Where the object should go.
+    */
+   void* Allocate(size_t size, size_t alignment)
+   {
+      alignment = jmax(alignment, alignof(Header));
+      for (;;)
+      {
+         if (nullptr != fNext)
+         {
+            const pointer_sized_uint object = (reinterpret_cast<pointer_sized_uint>(fNext) 
+               + sizeof(Header) + alignment - 1) & ~static_cast<pointer_sized_uint>(alignment - 1);
+            if (object + size <= reinterpret_cast<pointer_sized_uint>(fEnd))
+            {
+               fNext = reinterpret_cast<char*>(object + size);
+               return reinterpret_cast<void*>(object);
+            }
+         }
+         NextBlock(size + sizeof(Header) + alignment);
+      }
+   }
+
+   /**
+    * Move on to the next block that's at least `minSize` bytes long, 
+    * allocating one if needed.
+    */
+   void NextBlock(size_t minSize)
+   {
+      while (++fCurrentBlock < fBlocks.size())
+      {
+         const Block& b = fBlocks.getReference(fCurrentBlock);
+         if (b.size >= minSize)
+         {
+            fNext = b.data;
+            fEnd = b.data + b.size;
+            return;
+         }
+      }
+      Block b;
+      b.size = jmax(fBlockSize, minSize);
+      b.data = static_cast<char*>(std::malloc(b.size));
+      if (nullptr == b.data)
+      {
+         throw std::bad_alloc();
+      }
+      fBlocks.add(b);
+      fCurrentBlock = fBlocks.size() - 1;
+      fNext = b.data;
+      fEnd = b.data + b.size;
+   }
+
+   const size_t fBlockSize;
+   Array<Block> fBlocks;
+   int fCurrentBlock;
+   char* fNext;
+   char* fEnd;
+   /// the newest object.
+   Header* fLast;
+   int fNumObjects;
+
+   JUCE_DECLARE_NON_COPYABLE(ObjectArena)
+};
+
+
+#endif  // OBJECTARENA_H_INCLUDED
@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2016 Brett g Porter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above
+ * copyright notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS",
+ * WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef OBJECTPOOL_H_INCLUDED
+#define OBJECTPOOL_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+/**
+ * @class ObjectPool
+ *
+ * @brief A free list of fixed-size memory slots, carved out of larger 
+ *        chunks that are allocated as they're needed.
+ *
+ * Freed slots are handed out again first, so a type whose objects come and 
+ * go quickly keeps reusing the same (cache-warm) memory and never goes back 
+ * to the system allocator once the pool has grown big enough. Memory is only
+ * returned to the system when the pool is destroyed.
+ *
+ * The free slots live in two places: 
+ * - each thread has its own small stack of them, a Magazine, which it can 
+ *   use without any locking;
+ * - the pool itself holds the rest (the 'depot'). A thread whose magazine 
+ *   runs dry takes a batch of slots from the depot, and one whose magazine
+ *   fills up gives a batch back, so the depot's lock is only taken once 
+ *   every `kBatchSize` allocations or frees at most. 
+ *
+ * Slots are interchangeable, so an object can be freed on a different thread
+ * from the one that allocated it: its slot just goes into the freeing 
+ * thread's magazine, and makes its way back through the depot from there. 
+ * When a thread exits, its magazine returns everything to the depot.
+ *
+ * `Allocate()` and `Free()` on the pool itself skip the magazines and take the 
+ * lock every time.
+ */
+class ObjectPool
+{
+public:
+   enum
+   {
+      /// the most free slots that a magazine holds.
+      kMagazineSize = 32,
+      /// number of slots moved between a magazine and the depot at once.
+      kBatchSize = kMagazineSize / 2
+   };
+
+   /**
+    * @struct Stats
+    * @brief Counters describing how well the pool is doing.
+    *
+    * These count where allocations came from, not whether they reused freed 
+    * memory: a slot in a magazine may never have been used before, and a 
+    * trip to the depot may well be served from its free list. `highWater` 
+    * is what tells you how much memory the pool has needed.
+    */
+   struct Stats
+   {
+      /// every allocation, however it was served (`magazineHits + depotTrips`).
+      int64 allocations;
+      /// allocations served from a thread's magazine, without taking the lock.
+      int64 magazineHits;
+      /// allocations that took the depot's lock: a magazine refill, or a
+      /// call to `ObjectPool::Allocate()`.
+      int64 depotTrips;
+      /// number of objects currently allocated.
+      int live;
+      /// the most slots that have ever been out of the depot at once, 
+      /// either allocated or sitting in a thread's magazine -- i.e. the 
+      /// amount of memory that the pool has needed.
+      int highWater;
+   };
+
+   /**
+    * @class Magazine
+    * @brief One thread's cache of free slots from a pool. 
+    *
+    * Create one per thread (usually as a `thread_local`), and only use it 
+    * from that thread. 
+    */
+   class Magazine
+   {
+   public:
+      explicit Magazine(ObjectPool& pool)
+      :  fPool(pool)
+      ,  fCount(0)
+      ,  fMagazineHits(0)
+      ,  fDepotTrips(0)
+      ,  fFrees(0)
+      {
+         fPool.Attach(this);
+      }
+
+      ~Magazine()
+      {
+         fPool.Detach(this);
+      }
+
+      /**
+       * @return Memory for one object.
+       */
+      void* Allocate()
+      {
+         if (0 == fCount)
+         {
+            fPool.Refill(*this);
+            Increment(fDepotTrips);
+         }
+         else
+         {
+            Increment(fMagazineHits);
+         }
+         return fSlots[--fCount];
+      }
+
+      /**
+       * Give back a slot from this magazine's pool, which may have been 
+       * allocated by any thread.
+       */
+      void Free(void* p) noexcept
+      {
+         if (nullptr != p)
+         {
+            if (kMagazineSize == fCount)
+            {
+               fPool.Flush(*this, kBatchSize);
+            }
+            fSlots[fCount++] = p;
+            Increment(fFrees);
+         }
+      }
+
+   private:
+      friend class ObjectPool;
+
+      /**
+       * Only this magazine's thread changes its counters, so they don't 
+       * need a (slow) atomic read-modify-write, but they are atomic so that 
+       * `GetStats()` can read them from other threads.
+       */
+      static void Increment(std::atomic<int64>& counter) noexcept
+      {
+         counter.store(counter.load(std::memory_order_relaxed) + 1, 
+            std::memory_order_relaxed);
+      }
+
+      ObjectPool& fPool;
+      void* fSlots[kMagazineSize];
+      int fCount;
+      std::atomic<int64> fMagazineHits;
+      std::atomic<int64> fDepotTrips;
+      std::atomic<int64> fFrees;
+
+      JUCE_DECLARE_NON_COPYABLE(Magazine)
+   };
+
+   /**
+    * @param objectSize    Size of the objects that will be stored in the pool.
+    * @param slotsPerChunk Number of slots to allocate from the system at once.
+    */
+   explicit ObjectPool(size_t objectSize, int slotsPerChunk = 64)
+   :  fSlotSize(RoundUp(jmax(objectSize, sizeof(FreeSlot))))
+   ,  fSlotsPerChunk(slotsPerChunk)
+   ,  fFreeList(nullptr)
+   ,  fNext(nullptr)
+   ,  fEnd(nullptr)
+   ,  fMagazineHits(0)
+   ,  fDepotTrips(0)
+   ,  fFrees(0)
+   ,  fSlotsOut(0)
+   ,  fHighWater(0)
+   {
+      
+   }
+
+   ~ObjectPool()
+   {
+      // magazines should all have gone with their threads, and objects that
+      // outlive the pool would be left pointing at freed memory, so in that 
+      // case we leak it instead.
+      jassert(fMagazines.isEmpty());
+      jassert(0 == fSlotsOut);
+      if (0 == fSlotsOut)
+      {
+         for (void* chunk : fChunks)
+         {
+            std::free(chunk);
+         }
+      }
+   }
+
+   /**
+    * Get a slot straight from the depot, from the free list if possible.
+    * @return Memory for one object. Throws std::bad_alloc if the system is
+    *         out of memory.
+    */
+   void* Allocate()
+   {
+      const SpinLock::ScopedLockType sl(fLock);
+      ++fDepotTrips;
+      return TakeSlot();
+   }
+
+   /**
+    * Put a slot straight back in the depot.
+    * @param p Memory returned from this pool.
+    */
+   void Free(void* p) noexcept
+   {
+      if (nullptr != p)
+      {
+         const SpinLock::ScopedLockType sl(fLock);
+         ReturnSlot(p);
+         ++fFrees;
+      }
+   }
+
+   /**
+    * @return The pool's current statistics, including those of every 
+    *         thread's magazine. The counts are only exact when no other 
+    *         threads are using the pool.
+    */
+   Stats GetStats() const noexcept
+   {
+      const SpinLock::ScopedLockType sl(fLock);
+      int64 frees = fFrees;
+      Stats retval;
+      retval.magazineHits = fMagazineHits;
+      retval.depotTrips = fDepotTrips;
+      for (const Magazine* m : fMagazines)
+      {
+         retval.magazineHits += m->fMagazineHits.load(std::memory_order_relaxed);
+         retval.depotTrips += m->fDepotTrips.load(std::memory_order_relaxed);
+         frees += m->fFrees.load(std::memory_order_relaxed);
+      }
+      retval.allocations = retval.magazineHits + retval.depotTrips;
+      retval.live = static_cast<int>(retval.allocations - frees);
+      retval.highWater = fHighWater;
+      return retval;
+   }
+
+   /**
+    * @return The size of each slot, including any padding.
+    */
+   size_t GetSlotSize() const noexcept
+   {
+      return fSlotSize;
+   }
+
+private:
+   struct FreeSlot
+   {
+      FreeSlot* next;
+   };
+
+   static size_t RoundUp(size_t size) noexcept
+   {
+      const size_t alignment = alignof(std::max_align_t);
+      return (size + alignment - 1) & ~(alignment - 1);
+   }
+
+   void Attach(Magazine* magazine)
+   {
+      const SpinLock::ScopedLockType sl(fLock);
+      fMagazines.add(magazine);
+   }
+
+   /**
+    * Return a magazine's slots to the depot, and keep its counts.
+    */
+   void Detach(Magazine* magazine) noexcept
+   {
+      Flush(*magazine, magazine->fCount);
+      const SpinLock::ScopedLockType sl(fLock);
+      fMagazineHits += magazine->fMagazineHits.load(std::memory_order_relaxed);
+      fDepotTrips += magazine->fDepotTrips.load(std::memory_order_relaxed);
+      fFrees += magazine->fFrees.load(std::memory_order_relaxed);
+      fMagazines.removeFirstMatchingValue(magazine);
+   }
+
+   /**
+    * Move a batch of slots from the depot to an empty magazine.
+    */
+   void Refill(Magazine& magazine)
+   {
+      jassert(0 == magazine.fCount);
+      const SpinLock::ScopedLockType sl(fLock);
+      while (magazine.fCount < kBatchSize)
+      {
+         magazine.fSlots[magazine.fCount++] = TakeSlot();
+      }
+   }
+
+   /**
+    * Move `count` slots from a magazine back to the depot.
+    */
+   void Flush(Magazine& magazine, int count) noexcept
+   {
+      const SpinLock::ScopedLockType sl(fLock);
+      while (count-- > 0)
+      {
+         ReturnSlot(magazine.fSlots[--magazine.fCount]);
+      }
+   }
+
+   /// must be called with the lock held.
+   void* TakeSlot()
+   {
+      void* retval = nullptr;
+      if (nullptr != fFreeList)
+      {
+         retval = fFreeList;
+         fFreeList = fFreeList->next;
+      }
+      else
+      {
+         if (fNext == fEnd)
+         {
+            AddChunk();
+         }
+         retval = fNext;
+         fNext += fSlotSize;
+      }
+      fHighWater = jmax(fHighWater, ++fSlotsOut);
+      return retval;
+   }
+
+   /// must be called with the lock held.
+   void ReturnSlot(void* p) noexcept
+   {
+      FreeSlot* slot = static_cast<FreeSlot*>(p);
+      slot->next = fFreeList;
+      fFreeList = slot;
+      --fSlotsOut;
+   }
+
+   void AddChunk()
+   {
+      // malloc gives us max_align_t alignment, and so does every slot 
+      // because their size is a multiple of it.
+      char* chunk = static_cast<char*>(std::malloc(fSlotSize * fSlotsPerChunk));
+      if (nullptr == chunk)
+      {
+         throw std::bad_alloc();
+      }
+      fChunks.add(chunk);
+      fNext = chunk;
+      fEnd = chunk + fSlotSize * fSlotsPerChunk;
+   }
+
+   const size_t fSlotSize;
+   const int fSlotsPerChunk;
+   /// the depot.
+   FreeSlot* fFreeList;
+   /// the unused part of the newest chunk.
+   char* fNext;
+   char* fEnd;
+   Array<void*> fChunks;
+   Array<Magazine*> fMagazines;
+   /// counts for allocations that didn't use a magazine, and for magazines
+   /// that have been destroyed.
+   int64 fMagazineHits;
+   int64 fDepotTrips;
+   int64 fFrees;
+   /// slots that are allocated or in magazines.
+   int fSlotsOut;
+   int fHighWater;
+   SpinLock fLock;
+
+   JUCE_DECLARE_NON_COPYABLE(ObjectPool)
+};
+
+
+#endif  // OBJECTPOOL_H_INCLUDED
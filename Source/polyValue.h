@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2016 Brett g Porter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above
+ * copyright notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS",
+ * WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef POLYVALUE_H_INCLUDED
+#define POLYVALUE_H_INCLUDED
+
+#include "factory.h"
+#include "factoryDatabase.h"
+
+#include <cstddef>
+
+/**
+ * @class PolyValue
+ *
+ * @brief Holds one factory-created object by value, with the object stored 
+ *        inside the PolyValue itself if it fits in `N` bytes, and on the 
+ *        heap if it doesn't.
+ *
+ * Small, stateless classes like the ones in derived.h then don't need a heap
+ * allocation each, and can be kept in arrays and structs directly:
+ * ```
+ * PolyValue<Base> v("smaller");
+ * int x = v->SomeIntOperation(100);
+ *
+ * std::vector<PolyValue<Base>> values;
+ * values.emplace_back("bigger");
+ * ```
+ * PolyValues can be moved (which moves an inline object with its class's 
+ * move or copy constructor) but not copied. Classes that are too big, too 
+ * strictly aligned, or can't be moved live on the heap, created and 
+ * released as usual by their factories (so pooling and recycling still 
+ * apply).
+ */
+template <class T, size_t N = 32>
+class PolyValue
+{
+public:
+   /**
+    * An empty PolyValue.
+    */
+   PolyValue() noexcept
+   :  fObject(nullptr)
+   {
+
+   }
+
+   /**
+    * Create an object of a registered type.
+    * @param handle Handle to the type's factory. If it's invalid, the 
+    *               PolyValue is empty.
+    */
+   explicit PolyValue(const FactoryHandle<T>& handle)
+   :  PolyValue()
+   {
+      BaseFactory<T>* factory = handle.GetFactory();
+      if (nullptr != factory)
+      {
+         if (Fits(*factory))
+         {
+            fObject = factory->CreateAt(fStorage);
+         }
+         else
+         {
+            fObject = factory->TakeOrCreate();
+         }
+      }
+   }
+
+   explicit PolyValue(StringRef name)
+   :  PolyValue(T::Resolve(name))
+   {
+
+   }
+
+   explicit PolyValue(const TypeName& name)
+   :  PolyValue(T::Resolve(name))
+   {
+
+   }
+
+   PolyValue(PolyValue&& other)
+   :  PolyValue()
+   {
+      TakeFrom(other);
+   }
+
+   PolyValue& operator=(PolyValue&& other)
+   {
+      if (this != &other)
+      {
+         Clear();
+         TakeFrom(other);
+      }
+      return *this;
+   }
+
+   ~PolyValue()
+   {
+      Clear();
+   }
+
+   /**
+    * Destroy the object, leaving the PolyValue empty.
+    */
+   void Clear()
+   {
+      if (IsInline())
+      {
+         fObject->~T();
+      }
+      else if (nullptr != fObject)
+      {
+         T::Release(fObject);
+      }
+      fObject = nullptr;
+   }
+
+   /**
+    * @return true if this holds an object.
+    */
+   bool IsValid() const noexcept
+   {
+      return (nullptr != fObject);
+   }
+
+   /**
+    * @return true if the object is stored inside this PolyValue.
+    */
+   bool IsInline() const noexcept
+   {
+      const char* object = reinterpret_cast<const char*>(fObject);
+      return (object >= fStorage && object < fStorage + N);
+   }
+
+   T* get() const noexcept
+   {
+      return fObject;
+   }
+
+   T* operator->() const noexcept
+   {
+      jassert(nullptr != fObject);
+      return fObject;
+   }
+
+   T& operator*() const noexcept
+   {
+      jassert(nullptr != fObject);
+      return *fObject;
+   }
+
+private:
+   static bool Fits(const BaseFactory<T>& factory)
+   {
+      const FactoryLayout layout = factory.GetDescriptor().GetLayout();
+      return (layout.size > 0 && layout.size <= N 
+         && layout.alignment <= alignof(std::max_align_t) && factory.CanMove());
+   }
+
+   void TakeFrom(PolyValue& other)
+   {
+      if (other.IsInline())
+      {
+         BaseFactory<T>* factory = other.fObject->GetDescriptor()->GetFactory();
+         fObject = factory->MoveAt(*other.fObject, fStorage);
+         other.Clear();
+      }
+      else
+      {
+         fObject = other.fObject;
+         other.fObject = nullptr;
+      }
+   }
+
+   alignas(std::max_align_t) char fStorage[N];
+   /// either points into fStorage, or at an object on the heap.
+   T* fObject;
+
+   JUCE_DECLARE_NON_COPYABLE(PolyValue)
+};
+
+
+#endif  // POLYVALUE_H_INCLUDED
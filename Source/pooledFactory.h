@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2016 Brett g Porter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above
+ * copyright notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS",
+ * WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef POOLEDFACTORY_H_INCLUDED
+#define POOLEDFACTORY_H_INCLUDED
+
+#include "factory.h"
+#include "objectPool.h"
+
+
+/**
+ * @class PooledObject
+ *
+ * @brief The class that a PooledFactory actually creates: `Derived` with 
+ *        class-specific `operator new` and `operator delete` that use an 
+ *        ObjectPool shared by all `Derived` objects. 
+ *
+ * Because the destructors in the hierarchy are virtual, deleting one of these
+ * through a `T*` (e.g. with a `ScopedPointer<Base>`) finds our 
+ * `operator delete`, so the memory goes back to the pool without the caller
+ * knowing anything about it. 
+ */
+template <class Derived>
+class PooledObject : public Derived
+{
+public:
+   static_assert(alignof(Derived) <= alignof(std::max_align_t), 
+      "pooled objects can't be over-aligned");
+
+   PooledObject()
+   {
+
+   }
+
+   explicit PooledObject(const Derived& original)
+   :  Derived(original)
+   {
+
+   }
+
+   static void* operator new(size_t size)
+   {
+      jassert(size <= GetPool().GetSlotSize());
+      ignoreUnused(size);
+      ObjectPool::Magazine* magazine = GetMagazine();
+      return (nullptr != magazine) ? magazine->Allocate() : GetPool().Allocate();
+   }
+
+   static void operator delete(void* p) noexcept
+   {
+      ObjectPool::Magazine* magazine = GetMagazine();
+      if (nullptr != magazine)
+      {
+         magazine->Free(p);
+      }
+      else
+      {
+         GetPool().Free(p);
+      }
+   }
+
+   /**
+    * @return The pool that all `PooledObject<Derived>`s are allocated from.
+    */
+   static ObjectPool& GetPool()
+   {
+      static ObjectPool pool(sizeof(PooledObject));
+      return pool;
+   }
+
+   /**
+    * @return This thread's magazine of free slots from the pool, or nullptr
+    *         if it has already been destroyed -- i.e. we're being called from
+    *         the destructor of another `thread_local` (or, on the main 
+    *         thread, a static) as the thread exits. The caller should use the
+    *         pool directly in that case.
+    */
+   static ObjectPool::Magazine* GetMagazine()
+   {
+      // trivially destructible, so it can still be read after the thread's 
+      // other `thread_local`s have been destroyed.
+      static thread_local bool destroyed = false;
+      if (destroyed)
+      {
+         return nullptr;
+      }
+      static thread_local MagazineHolder holder(destroyed);
+      return &holder.magazine;
+   }
+
+private:
+   /**
+    * Sets a flag as soon as the magazine starts being destroyed.
+    */
+   struct MagazineHolder
+   {
+      explicit MagazineHolder(bool& destroyedFlag)
+      :  magazine(GetPool())
+      ,  destroyed(destroyedFlag)
+      {
+
+      }
+
+      ~MagazineHolder()
+      {
+         destroyed = true;
+      }
+
+      ObjectPool::Magazine magazine;
+      bool& destroyed;
+   };
+};
+
+
+/**
+ * @class PooledFactory
+ *
+ * @brief A drop-in replacement for Factory<T, Derived> that allocates its 
+ *        objects from a per-type ObjectPool instead of the heap. 
+ *
+ * Objects are used and deleted exactly as before:
+ * ```
+ * PooledFactory<Base, Smaller> smallerFactory("smaller");
+ * ...
+ * ScopedPointer<Base> s = Base::Create("smaller");   // from the pool
+ * s = nullptr;                                       // back to the pool
+ * ```
+ * The objects really are `PooledObject<Derived>`s, so `dynamic_cast` to 
+ * `Derived` works as usual, but `typeid` comparisons with `Derived` don't.
+ */
+template <class T, class Derived>
+class PooledFactory : public Factory<T, Derived>
+{
+public:
+   PooledFactory(StringRef typeName)
+   :  Factory<T, Derived>(typeName, FactoryDeleter<T>(&Destroy))
+   {
+
+   }
+
+   PooledFactory(StringRef typeName, UnregisteredFactory unregistered)
+   :  Factory<T, Derived>(typeName, FactoryDeleter<T>(&Destroy), unregistered)
+   {
+
+   }
+
+   ~PooledFactory() = default;
+
+   T* Create() override
+   {
+      T* retval = new PooledObject<Derived>();
+      retval->SetDescriptor(&(BaseFactory<T>::fDescriptor));
+      return retval;
+   }
+
+   T* CreateWith() override
+   {
+      return Create();
+   }
+
+   // Objects in an arena, or made using `CreateAt()`, don't need the pool, 
+   // so those are plain `Derived`s made by the Factory base class.
+
+   T* Clone(const T& original) override
+   {
+      return Copy(original, std::is_copy_constructible<Derived>());
+   }
+
+   /**
+    * @return Statistics for the pool that this factory's objects use.
+    */
+   ObjectPool::Stats GetPoolStats() const
+   {
+      return PooledObject<Derived>::GetPool().GetStats();
+   }
+
+private:
+   T* Copy(const T& original, std::true_type)
+   {
+      T* retval = new PooledObject<Derived>(static_cast<const Derived&>(original));
+      retval->SetDescriptor(&(BaseFactory<T>::fDescriptor));
+      return retval;
+   }
+
+   T* Copy(const T&, std::false_type)
+   {
+      // Derived doesn't have a copy constructor.
+      jassertfalse;
+      return nullptr;
+   }
+
+   static void Destroy(T* object)
+   {
+      delete static_cast<PooledObject<Derived>*>(object);
+   }
+};
+
+
+#endif  // POOLEDFACTORY_H_INCLUDED
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2016 Brett g Porter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above
+ * copyright notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS",
+ * WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SNAPSHOTPOINTER_H_INCLUDED
+#define SNAPSHOTPOINTER_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+#include <atomic>
+
+/**
+ * @class SnapshotPointer
+ *
+ * @brief A pointer to an immutable snapshot object that many threads can read
+ *        without locking while another thread replaces it.
+ *
+ * This is a small read-copy-update (RCU) scheme:
+ *
+ * - Readers create a `ReadGuard`, which gives them the current snapshot 
+ *   with a single atomic load. The guard marks the reader as active in one of
+ *   a fixed set of per-thread counters, each on its own cache line, so 
+ *   readers on different threads don't contend with each other or with 
+ *   writers.
+ * - Writers build a complete new snapshot and `Publish()` it. The old one is
+ *   retired rather than deleted, because readers may still be using it.
+ * - Reclamation uses two alternating epochs. Readers register in the counter 
+ *   for the epoch they started in; the epoch can only advance once nobody is
+ *   left in the counter it's about to reuse. A snapshot retired in epoch E 
+ *   can't be seen by any reader once the epoch has reached E + 2, and is 
+ *   deleted the next time a writer calls `Publish()` or `Reclaim()`. Nothing
+ *   ever waits for readers.
+ *
+ * Writers must serialise themselves using `GetWriterLock()`. Read guards 
+ * are meant to be short-lived: a reader that sits on a guard forever will
+ * stop old snapshots from being deleted (but nothing worse than that).
+ */
+template <class Snapshot>
+class SnapshotPointer
+{
+public:
+   SnapshotPointer()
+   :  fCurrent(nullptr)
+   ,  fEpoch(0)
+   {
+      for (ReaderCounts& r : fReaders)
+      {
+         r.counts[0].store(0);
+         r.counts[1].store(0);
+      }
+   }
+
+   /**
+    * Deletes the current and any retired snapshots; there must be no active
+    * readers when this happens.
+    */
+   ~SnapshotPointer()
+   {
+      delete fCurrent.load();
+      for (const Retired& r : fRetired)
+      {
+         delete r.snapshot;
+      }
+   }
+
+   /**
+    * @class ReadGuard
+    * @brief Keeps the snapshot that was current when it was created alive 
+    *        until the guard is destroyed.
+    */
+   class ReadGuard
+   {
+   public:
+      explicit ReadGuard(SnapshotPointer& owner) noexcept
+      :  fCounters(owner.fReaders[ReaderSlot()].counts)
+      {
+         for (;;)
+         {
+            fEpoch = owner.fEpoch.load();
+            fCounters[fEpoch & 1].fetch_add(1);
+            // if a writer moved the epoch on before we registered, our 
+            // counter may already have been checked -- try again.
+            if (owner.fEpoch.load() == fEpoch)
+            {
+               break;
+            }
+            fCounters[fEpoch & 1].fetch_sub(1);
+         }
+         fSnapshot = owner.fCurrent.load();
+      }
+
+      ~ReadGuard() noexcept
+      {
+         fCounters[fEpoch & 1].fetch_sub(1, std::memory_order_release);
+      }
+
+      /**
+       * @return the snapshot (may be nullptr if nothing was ever published).
+       */
+      const Snapshot* get() const noexcept
+      {
+         return fSnapshot;
+      }
+
+      const Snapshot* operator->() const noexcept
+      {
+         return fSnapshot;
+      }
+
+   private:
+      std::atomic<int>* fCounters;
+      uint32 fEpoch;
+      const Snapshot* fSnapshot;
+
+      JUCE_DECLARE_NON_COPYABLE(ReadGuard)
+   };
+
+   /**
+    * Replace the current snapshot. Readers that already hold the old one can
+    * keep using it; it's deleted once they're all gone. The caller must hold
+    * the writer lock.
+    * @param snapshot new snapshot (may be nullptr). We take ownership.
+    */
+   void Publish(Snapshot* snapshot)
+   {
+      Snapshot* old = fCurrent.exchange(snapshot);
+      if (old)
+      {
+         Retired r = { old, fEpoch.load() };
+         fRetired.add(r);
+      }
+      Reclaim();
+   }
+
+   /**
+    * Delete any retired snapshots that no reader can still be using. The 
+    * caller must hold the writer lock.
+    * @return the number of snapshots still waiting to be deleted.
+    */
+   int Reclaim()
+   {
+      for (int i = 0; i < 2; ++i)
+      {
+         const uint32 epoch = fEpoch.load();
+         if (HasReaders((epoch + 1) & 1))
+         {
+            break;
+         }
+         fEpoch.store(epoch + 1);
+      }
+
+      const uint32 epoch = fEpoch.load();
+      for (int i = fRetired.size(); --i >= 0;)
+      {
+         if (epoch - fRetired.getReference(i).epoch >= 2)
+         {
+            delete fRetired.getReference(i).snapshot;
+            fRetired.remove(i);
+         }
+      }
+      return fRetired.size();
+   }
+
+   /**
+    * Read the current snapshot without any protection. Only safe when no 
+    * other thread can be publishing at the same time.
+    */
+   const Snapshot* GetUnprotected() const noexcept
+   {
+      return fCurrent.load(std::memory_order_relaxed);
+   }
+
+   /**
+    * @return the lock that writers need to hold while building and 
+    *         publishing snapshots.
+    */
+   CriticalSection& GetWriterLock() noexcept
+   {
+      return fWriterLock;
+   }
+
+private:
+   enum 
+   { 
+      kNumReaderSlots = 64,
+      kCacheLineSize = 64
+   };
+
+   /// A pair of reader counts (one per epoch parity) on its own cache line.
+   struct ReaderCounts
+   {
+      std::atomic<int> counts[2];
+      char padding[kCacheLineSize - 2 * sizeof(std::atomic<int>)];
+   };
+
+   struct Retired
+   {
+      Snapshot* snapshot;
+      uint32 epoch;
+   };
+
+   /**
+    * Threads are handed reader slots round robin the first time they read.
+    * With more threads than slots some will share, which is still correct, 
+    * just a little slower.
+    */
+   static int ReaderSlot() noexcept
+   {
+      static std::atomic<int> nextSlot(0);
+      static thread_local const int slot = nextSlot.fetch_add(1) % kNumReaderSlots;
+      return slot;
+   }
+
+   bool HasReaders(uint32 parity) const noexcept
+   {
+      for (int i = 0; i < kNumReaderSlots; ++i)
+      {
+         if (0 != fReaders[i].counts[parity].load())
+         {
+            return true;
+         }
+      }
+      return false;
+   }
+
+   ReaderCounts fReaders[kNumReaderSlots];
+   std::atomic<Snapshot*> fCurrent;
+   std::atomic<uint32> fEpoch;
+   Array<Retired> fRetired;
+   CriticalSection fWriterLock;
+
+   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SnapshotPointer)
+};
+
+
+#endif  // SNAPSHOTPOINTER_H_INCLUDED
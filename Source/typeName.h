@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2016 Brett g Porter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above
+ * copyright notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS",
+ * WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TYPENAME_H_INCLUDED
+#define TYPENAME_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/**
+ * @file
+ * Hashing for the 'type names' that factories are registered under. 
+ *
+ * We use 64-bit FNV-1a over the UTF-8 bytes of the name. It's cheap, it works
+ * directly on the bytes a StringRef points at (so there's no need to build a 
+ * juce::String just to find out what hash bucket a name lives in), and with 
+ * 64 bits of output collisions between the handful of names registered for a
+ * class hierarchy are vanishingly unlikely. 
+ *
+ * The same hash can be calculated at compile time for names that are string
+ * literals -- see the TypeName class below.
+ */
+
+namespace TypeNameHash
+{
+   constexpr uint64 kOffsetBasis = 14695981039346656037ULL;
+   constexpr uint64 kPrime = 1099511628211ULL;
+
+   /**
+    * Hash a NUL-terminated UTF-8 type name.
+    * @param  name   the type name.
+    * @param  length if not null, receives the length of the name in bytes.
+    * @return        64-bit FNV-1a hash of the name.
+    */
+   inline uint64 Calculate(const char* name, size_t* length = nullptr) noexcept
+   {
+      uint64 hash = kOffsetBasis;
+      const char* p = name;
+      for (; *p != 0; ++p)
+      {
+         hash = (hash ^ static_cast<uint8>(*p)) * kPrime;
+      }
+      if (length)
+      {
+         *length = static_cast<size_t>(p - name);
+      }
+      return hash;
+   }
+
+   inline uint64 Calculate(StringRef name, size_t* length = nullptr) noexcept
+   {
+      return Calculate(name.text.getAddress(), length);
+   }
+
+   /**
+    * Compile-time version of `Calculate()` (written as a single recursive 
+    * expression to keep C++11 constexpr rules happy). Gives exactly the same
+    * result as the runtime version for the same bytes.
+    * @param  name   the type name.
+    * @param  length number of bytes in the name.
+    * @param  hash   hash of the bytes preceding `name`.
+    */
+   constexpr uint64 CalculateConstant(const char* name, size_t length, 
+      uint64 hash = kOffsetBasis) noexcept
+   {
+      return (0 == length) ? hash 
+         : CalculateConstant(name + 1, length - 1, (hash ^ static_cast<uint8>(*name)) * kPrime);
+   }
+
+   /**
+    * Compile-time `strlen()` that won't look past `maxLength` bytes.
+    */
+   constexpr size_t LengthConstant(const char* name, size_t maxLength, size_t i = 0) noexcept
+   {
+      return (i >= maxLength || 0 == name[i]) ? i : LengthConstant(name, maxLength, i + 1);
+   }
+
+   /**
+    * Scramble a hash value so that all of its bits depend on all of the bits
+    * of the input (this is the finaliser from MurmurHash3). FNV's low bits are
+    * fairly weak on their own, so anything that reduces a hash down into a 
+    * small range should mix it first.
+    */
+   inline uint64 Mix(uint64 h) noexcept
+   {
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ULL;
+      h ^= h >> 33;
+      return h;
+   }
+
+   /**
+    * Map a 32-bit value into the range [0, range) using a multiply and a 
+    * shift instead of a (much slower) modulo.
+    */
+   inline uint32 Reduce(uint32 value, uint32 range) noexcept
+   {
+      return static_cast<uint32>((static_cast<uint64>(value) * range) >> 32);
+   }
+}
+
+
+/**
+ * @class TypeName
+ * @brief A type name whose hash is calculated at compile time.
+ *
+ * Declare the names used for a class hierarchy as constants:
+ * ```
+ * constexpr TypeName kSmaller("smaller");
+ * ```
+ * (or use the `"smaller"_type` literal) and they can be passed to `Create()`
+ * without being hashed again at runtime. A TypeName constant can also be used
+ * as a template argument:
+ * ```
+ * Base* s = Base::Create<kSmaller>();
+ * ```
+ * which resolves the factory the first time that line runs and never looks it
+ * up again.
+ *
+ * Since the hashes are constants, `TypeName::AreDistinct()` can check a 
+ * hierarchy's names for hash collisions in a `static_assert`. That only 
+ * covers the names that are listed, though; names registered with 
+ * `FACTORY_RECORD()` are also checked when their hierarchy's 
+ * FactoryRecordIndex is built.
+ */
+class TypeName
+{
+public:
+   /**
+    * Make a TypeName from a string literal (or a constant array holding 
+    * one). The name ends at the first NUL, so a constant buffer that's 
+    * bigger than its contents gets the right length too. Arrays that aren't 
+    * `const` could change after the hash has been calculated, so they 
+    * aren't allowed.
+    */
+   template <size_t N>
+   constexpr explicit TypeName(const char (&name)[N]) noexcept
+   :  fName(name)
+   ,  fLength(TypeNameHash::LengthConstant(name, N - 1))
+   ,  fHash(TypeNameHash::CalculateConstant(name, TypeNameHash::LengthConstant(name, N - 1)))
+   {
+
+   }
+
+   template <size_t N>
+   explicit TypeName(char (&name)[N]) = delete;
+
+   constexpr TypeName(const char* name, size_t length) noexcept
+   :  fName(name)
+   ,  fLength(length)
+   ,  fHash(TypeNameHash::CalculateConstant(name, length))
+   {
+
+   }
+
+   /**
+    * @return The name as a NUL-terminated UTF-8 string.
+    */
+   constexpr const char* GetName() const noexcept
+   {
+      return fName;
+   }
+
+   /**
+    * @return Length of the name in bytes.
+    */
+   constexpr size_t GetLength() const noexcept
+   {
+      return fLength;
+   }
+
+   /**
+    * @return Hash of the name, identical to `TypeNameHash::Calculate(GetName())`.
+    */
+   constexpr uint64 GetHash() const noexcept
+   {
+      return fHash;
+   }
+
+   operator StringRef() const noexcept
+   {
+      return StringRef(fName);
+   }
+
+   /**
+    * Check that no two names in an array have the same hash. This only 
+    * covers the names in the array you give it -- it can't see names that 
+    * are recorded or registered anywhere else, so a collision between one 
+    * of these and, say, a `FACTORY_RECORD()` name in another file isn't 
+    * caught at compile time. (Debug builds catch recorded names when the 
+    * record index is built, and registered names when a frozen table is 
+    * built.)
+    * ```
+    * constexpr TypeName kAllNames[] = { kUnity, kSmaller, kBigger };
+    * static_assert(TypeName::AreDistinct(kAllNames), "type name hash collision");
+    * ```
+    */
+   template <size_t N>
+   static constexpr bool AreDistinct(const TypeName (&names)[N], size_t i = 0) noexcept
+   {
+      return (i >= N) || (NoneMatch(names, i, i + 1) && AreDistinct(names, i + 1));
+   }
+
+private:
+   /// @return true if none of names[j...] has the same hash as names[i].
+   template <size_t N>
+   static constexpr bool NoneMatch(const TypeName (&names)[N], size_t i, size_t j) noexcept
+   {
+      return (j >= N) || ((names[i].fHash != names[j].fHash) && NoneMatch(names, i, j + 1));
+   }
+
+   const char* fName;
+   size_t fLength;
+   uint64 fHash;
+};
+
+
+/**
+ * Literal suffix for compile-time type names: `Base::Create("unity"_type)`
+ */
+constexpr TypeName operator"" _type(const char* name, size_t length) noexcept
+{
+   return TypeName(name, length);
+}
+
+
+#endif  // TYPENAME_H_INCLUDED